@@ -0,0 +1,64 @@
+#include "br_coalesce.h"
+#include "br_retry.h"
+#include "sl_sleeptimer.h"
+#include "../common/meter_proto.h"
+
+/* Transactions are few (BR_TXN_MAX), so every lookup here is a short scan
+   of the txn table plus bitmap compares. */
+
+uint32_t br_coalesce_hash(const uint8_t *payload, uint16_t len)
+{
+    uint32_t h = 2166136261u;
+    for (uint16_t i = 0; i < len; i++) {
+        h = (h ^ payload[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool covers(const br_txn_t *primary, const br_txn_t *txn)
+{
+    for (uint16_t i = 0; i < BR_TXN_NODE_BITMAP; i++) {
+        if (txn->expected[i] & ~primary->expected[i]) return false;   // not a subset
+        if (txn->expected[i] & primary->replied[i]) return false;     // reply already forwarded
+    }
+    return true;
+}
+
+br_txn_t *br_coalesce_find(const br_txn_t *txn, const uint8_t *payload,
+                           const uint8_t *opts, uint8_t opts_len)
+{
+    uint32_t window = sl_sleeptimer_ms_to_tick(BR_COALESCE_WINDOW_MS);
+
+    for (uint16_t i = 0; i < BR_TXN_MAX; i++) {
+        br_txn_t *p = br_txn_get_slot(i);
+        if (!p || p == txn || p->primary != METER_TXN_NONE) continue;
+        if (p->req_hash != txn->req_hash || p->req_len != txn->req_len) continue;
+        if ((uint32_t)(txn->open_tick - p->open_tick) > window) continue;
+        if (!txn->targeted && p->reply_count) continue;
+        if (!covers(p, txn)) continue;
+        /* The hash only narrows it down: the primary's stored request must match byte for byte */
+        if (br_retry_same_request(p, opts, opts_len, payload, txn->req_len)) return p;
+    }
+    return NULL;
+}
+
+void br_coalesce_fanout(uint16_t primary_id, uint16_t node, uint8_t flags,
+                        const uint8_t *payload, uint16_t len, br_coalesce_fwd_t fwd)
+{
+    for (uint16_t i = 0; i < BR_TXN_MAX; i++) {
+        br_txn_t *a = br_txn_get_slot(i);
+        if (!a || a->primary != primary_id) continue;
+        if (a->targeted && !br_txn_bit(a->expected, node)) continue;
+        if (br_txn_record_reply(a->txn_id, node) == BR_TXN_REPLY_FIRST) {
+            fwd(a->txn_id, node, flags, payload, len);
+        }
+    }
+}
+
+void br_coalesce_finish_aliases(uint16_t primary_id, br_txn_done_t reason)
+{
+    for (uint16_t i = 0; i < BR_TXN_MAX; i++) {
+        br_txn_t *a = br_txn_get_slot(i);
+        if (a && a->primary == primary_id) br_txn_finish(a, reason);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef BR_COALESCE_H
+#define BR_COALESCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "br_txn.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Only requests arriving within this time of the original are coalesced */
+#ifndef BR_COALESCE_WINDOW_MS
+#define BR_COALESCE_WINDOW_MS 5000
+#endif
+
+/** Hash of a Push3 request payload */
+uint32_t br_coalesce_hash(const uint8_t *payload, uint16_t len);
+
+/**
+ * Find an in-flight transaction that txn (already opened, expected set and
+ * req_hash/req_len filled in) can ride on instead of going on air: same
+ * payload and reply-shaping options (compared against the copy br_retry
+ * keeps), opened within BR_COALESCE_WINDOW_MS, expected set covering txn's,
+ * and none of txn's nodes answered yet. Returns NULL if there is none.
+ */
+br_txn_t *br_coalesce_find(const br_txn_t *txn, const uint8_t *payload,
+                           const uint8_t *opts, uint8_t opts_len);
+
+/**
+ * Fan a reply to primary_id out to the transactions coalesced onto it.
+ * fwd is called once for every alias that should see the reply.
+ */
+typedef void (*br_coalesce_fwd_t)(uint16_t txn_id, uint16_t node, uint8_t flags,
+                                  const uint8_t *payload, uint16_t len);
+void br_coalesce_fanout(uint16_t primary_id, uint16_t node, uint8_t flags,
+                        const uint8_t *payload, uint16_t len, br_coalesce_fwd_t fwd);
+
+/** Complete every transaction coalesced onto primary_id with the same reason */
+void br_coalesce_finish_aliases(uint16_t primary_id, br_txn_done_t reason);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BR_COALESCE_H
@@ -0,0 +1,123 @@
+#include "br_delta.h"
+#include "../common/meter_proto.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include <string.h>
+#include <stdbool.h>
+
+#if BR_DELTA_KEYS >= 0xFFFF
+#error "BR_DELTA_KEYS must be below 0xFFFF"
+#endif
+
+#define KEY_NONE 0xFFFF
+
+typedef struct {
+    bool     used;
+    uint16_t node;
+    uint16_t next;              /* next key of the same node, KEY_NONE at the end */
+    uint8_t  key_id;
+    uint8_t  layout;
+    uint32_t used_tick;
+    uint16_t len;
+    uint8_t  frame[METER_DELTA_FRAME_MAX];
+} br_delta_key_t;
+
+static br_delta_key_t keys[BR_DELTA_KEYS];
+static uint16_t node_keys[BR_NODE_MAX];     /* first key of each node, KEY_NONE if none */
+static uint8_t out_frame[METER_DELTA_FRAME_MAX];
+
+void br_delta_init(void)
+{
+    memset(keys, 0, sizeof(keys));
+    for (int i = 0; i < BR_NODE_MAX; i++) node_keys[i] = KEY_NONE;
+}
+
+void br_delta_forget_node(uint16_t node)
+{
+    if (node >= BR_NODE_MAX) return;
+    for (uint16_t i = node_keys[node]; i != KEY_NONE; i = keys[i].next) keys[i].used = false;
+    node_keys[node] = KEY_NONE;
+}
+
+/* Walks only node's own keys (one per delta-coded schedule) */
+static br_delta_key_t *key_find(uint16_t node, uint8_t key_id)
+{
+    if (node >= BR_NODE_MAX) return NULL;
+    for (uint16_t i = node_keys[node]; i != KEY_NONE; i = keys[i].next) {
+        if (keys[i].key_id == key_id) return &keys[i];
+    }
+    return NULL;
+}
+
+static void key_unlink(uint16_t idx)
+{
+    uint16_t *link = &node_keys[keys[idx].node];
+    while (*link != idx) link = &keys[*link].next;
+    *link = keys[idx].next;
+    keys[idx].used = false;
+}
+
+/* Slot for (node, key_id), linked to node; NULL for a node outside the registry */
+static br_delta_key_t *key_alloc(uint16_t node, uint8_t key_id)
+{
+    if (node >= BR_NODE_MAX) return NULL;
+    br_delta_key_t *k = key_find(node, key_id);
+    if (k) return k;
+
+    uint16_t idx = 0;
+    for (uint16_t i = 0; i < BR_DELTA_KEYS; i++) {
+        if (!keys[i].used) {
+            idx = i;
+            break;
+        }
+        if ((int32_t)(keys[i].used_tick - keys[idx].used_tick) < 0) idx = i;
+    }
+    if (keys[idx].used) key_unlink(idx);
+
+    k = &keys[idx];
+    k->used = true;
+    k->node = node;
+    k->key_id = key_id;
+    k->next = node_keys[node];
+    node_keys[node] = idx;
+    return k;
+}
+
+int br_delta_unpack(uint16_t node, uint8_t flags, const uint8_t **payload, uint16_t *len)
+{
+    if (!(flags & (METER_F_KEYFRAME | METER_F_DELTA))) return 0;
+    if (*len < 2) return -1;
+
+    const uint8_t *p = *payload;
+    uint8_t layout = p[0];
+    uint8_t key_id = p[1];
+    uint16_t body_len = (uint16_t)(*len - 2);
+
+    if (flags & METER_F_KEYFRAME) {
+        if (body_len > METER_DELTA_FRAME_MAX) return -1;
+        br_delta_key_t *k = key_alloc(node, key_id);
+        if (!k) return -1;
+        k->layout = layout;
+        k->len = body_len;
+        k->used_tick = sl_sleeptimer_get_tick_count();
+        memcpy(k->frame, &p[2], body_len);
+        *payload = &p[2];
+        *len = body_len;
+        return 0;
+    }
+
+    br_delta_key_t *k = key_find(node, key_id);
+    if (!k || k->layout != layout) {
+        LOG_WARN("[BR] delta from node %u against unknown keyframe %u", (unsigned)node, (unsigned)key_id);
+        return BR_DELTA_NO_KEY;
+    }
+    int n = meter_delta_decode(layout, k->frame, k->len, &p[2], body_len, out_frame, sizeof(out_frame));
+    if (n < 0) {
+        LOG_WARN("[BR] bad delta from node %u", (unsigned)node);
+        return -1;
+    }
+    k->used_tick = sl_sleeptimer_get_tick_count();
+    *payload = out_frame;
+    *len = (uint16_t)n;
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef BR_DELTA_H
+#define BR_DELTA_H
+
+#include <stdint.h>
+#include "../common/meter_delta.h"
+#include "br_nodes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Keyframes kept for decoding deltas, at least one per registry node so
+   scheduled reports from a full PAN don't evict each other; past that the
+   least recently used is replaced. Each costs METER_DELTA_FRAME_MAX bytes
+   plus a few of bookkeeping. */
+#ifndef BR_DELTA_KEYS
+#define BR_DELTA_KEYS BR_NODE_MAX
+#endif
+
+void br_delta_init(void);
+
+/** Drop every keyframe kept for node */
+void br_delta_forget_node(uint16_t node);
+
+/* br_delta_unpack(): a delta against a keyframe this BR doesn't hold */
+#define BR_DELTA_NO_KEY (-2)
+
+/**
+ * Turn a delta-coded NR payload (hdr flags METER_F_KEYFRAME / METER_F_DELTA)
+ * back into the meter frame. Keyframes are remembered per node and key id.
+ * On success *payload / *len point at the meter frame (valid until the next
+ * call) and 0 is returned; BR_DELTA_NO_KEY if its keyframe is unknown (the
+ * node should be asked for a new one), -1 if the payload is malformed.
+ * Payloads without those flags are left untouched.
+ */
+int br_delta_unpack(uint16_t node, uint8_t flags, const uint8_t **payload, uint16_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BR_DELTA_H
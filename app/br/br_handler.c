@@ -1,36 +1,140 @@
 #include "br_handler.h"
+#include "br_txn.h"
+#include "br_nodes.h"
+#include "br_retry.h"
+#include "br_coalesce.h"
+#include "br_delta.h"
+#include "br_reasm.h"
 #include "stack_if.h"
 #include "log.h"
 #include <string.h>
 #include <stdio.h>
 #include "../common/ipv6_utils.h"
+#include "../common/meter_proto.h"
 #include "push3_if.h"
+#include "sl_sleeptimer.h"
 
-/* Multicast group used by BR->NR requests (example) */
-static const uint8_t BR_NRS_MULTICAST_ADDR[16] = {
-    0xff, 0x03, 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00, 0x12,0x34,0x56,0x78
-};
+/* Multicast group used by BR->NR requests */
+static const uint8_t BR_NRS_MULTICAST_ADDR[16] = METER_NRS_MULTICAST_ADDR;
 
-static const uint16_t PUSH3_PORT = 4000;
+static const uint16_t PUSH3_PORT = METER_UDP_PORT;
 
-/* Local buffer for collecting NR responses if you want to aggregate */
-#define MAX_REPLY 512
+/* Largest request (header + Push3 payload) the BR will put on the air */
+#define MAX_REQUEST 512
+
+static uint8_t req_buf[MAX_REQUEST];
+
+/* Reply window advertised to NRs: one slot per expected replier, capped */
+#ifndef BR_REPLY_SLOT_MS
+#define BR_REPLY_SLOT_MS 40
+#endif
+#ifndef BR_REPLY_MAX_SLOTS
+#define BR_REPLY_MAX_SLOTS 64
+#endif
+
+/* Time allowed after the reply window for mesh latency and the meter exchange */
+#ifndef BR_TXN_DEADLINE_MARGIN_MS
+#define BR_TXN_DEADLINE_MARGIN_MS 5000
+#endif
+
+/* Max age of cached meter data NRs may answer with; 0 leaves it to the NR */
+static uint16_t reply_max_age_s = 0;
+
+/* Extraction plan NRs run over the meter reply; empty sends the whole frame */
+static uint8_t extract_plan[METER_EXTRACT_SEL_LEN * METER_EXTRACT_MAX_SEL];
+static uint8_t extract_plan_len = 0;
+
+static void br_txn_done(br_txn_t *txn, br_txn_done_t reason);
+static void br_handle_msg(uint16_t node, const meter_hdr_t *m);
+
+/* Registry index handed to a new node: forget the old one's keyframes and
+   make the host learn the new address before the index shows up again */
+static void br_node_evicted(uint16_t node)
+{
+    br_delta_forget_node(node);
+    push3_forget_node(node);
+}
+
+/* Delta against a keyframe we don't hold: ask the node to start over */
+static void br_request_keyframe(uint16_t node, uint8_t key_id)
+{
+    uint8_t msg[METER_HDR_BASE_LEN + 1];
+    meter_hdr_t hdr = {
+        .type = METER_MSG_KEY_NACK,
+        .txn_id = METER_TXN_NONE,
+    };
+    int hlen = meter_hdr_encode(msg, sizeof(msg), &hdr);
+    if (hlen < 0) return;
+    msg[hlen] = key_id;
+    if (wsun_send_unicast(br_nodes_get(node)->ipv6, PUSH3_PORT, msg, (uint16_t)(hlen + 1)) != 0) {
+        LOG_WARN("[BR] keyframe request to node %u not sent", (unsigned)node);
+    }
+}
 
 void br_handler_init(void)
 {
     LOG_INFO("[BR] br_handler_init");
+    br_txn_init(br_txn_done, br_retry_on_expiry);
+    br_retry_init();
+    br_nodes_init(br_node_evicted);
+    br_delta_init();
+    br_reasm_init(br_handle_msg);
+    push3_if_init();
     wsun_register_rx_cb(br_handle_nr_reply);
+    wsun_register_topology_cb(br_nodes_mark_dirty);
 }
 
 /* Called by external Push3 interface. Returns 0 if multicast sent. */
-int br_send_meter_request_from_push3(const uint8_t *payload, uint16_t len)
+int br_send_meter_request_from_push3(const uint8_t *payload, uint16_t len, uint16_t *txn_id)
 {
-    if (!payload || len == 0) {
-        LOG_WARN("[BR] empty push3 request");
+    return br_send_targeted_meter_request(payload, len, NULL, 0, txn_id);
+}
+
+int br_send_targeted_meter_request(const uint8_t *payload, uint16_t len,
+                                   const uint8_t (*targets)[16], uint16_t n_targets,
+                                   uint16_t *txn_id)
+{
+    return br_send_scheduled_meter_request(payload, len, targets, n_targets, NULL, txn_id);
+}
+
+/* Multicast one REQUEST: a target filter over targets[0..n) (none if n is 0)
+   followed by the tail options, then payload */
+static int br_multicast_request(uint16_t txn_id, const uint8_t (*targets)[16], uint16_t n,
+                                const uint8_t *tail, uint8_t tail_len,
+                                const uint8_t *payload, uint16_t len)
+{
+    uint8_t opts[METER_HDR_MAX_OPTS];
+    int opts_len = 0;
+    if (n) {
+        uint8_t bloom[METER_BLOOM_MAX_BYTES];
+        uint8_t bloom_len = meter_bloom_size_for(n);
+        memset(bloom, 0, bloom_len);
+        for (uint16_t i = 0; i < n; i++) {
+            meter_bloom_add(bloom, bloom_len, &targets[i][8]);
+        }
+        opts_len = meter_opt_put(opts, 0, sizeof(opts), METER_OPT_TARGET_BLOOM, bloom, bloom_len);
+    }
+    if (opts_len < 0 || (size_t)opts_len + tail_len > sizeof(opts)) {
+        LOG_WARN("[BR] request options overflow, txn=%u", (unsigned)txn_id);
         return -1;
     }
-    LOG_INFO("[BR] push3 -> multicast to NRs, len=%u", (unsigned)len);
-    int rc = wsun_send_multicast(BR_NRS_MULTICAST_ADDR, PUSH3_PORT, payload, len);
+    memcpy(&opts[opts_len], tail, tail_len);
+    opts_len += tail_len;
+
+    meter_hdr_t hdr = {
+        .type = METER_MSG_REQUEST,
+        .txn_id = txn_id,
+        .opts = opts,
+        .opts_len = (uint8_t)opts_len,
+    };
+    int hlen = meter_hdr_encode(req_buf, sizeof(req_buf), &hdr);
+    if (hlen < 0 || len > sizeof(req_buf) - (uint16_t)hlen) {
+        LOG_WARN("[BR] push3 request too large len=%u", (unsigned)len);
+        return -1;
+    }
+    memcpy(&req_buf[hlen], payload, len);
+
+    int rc = wsun_send_multicast(BR_NRS_MULTICAST_ADDR, PUSH3_PORT, req_buf, (uint16_t)(hlen + len));
     if (rc != 0) {
         LOG_ERROR("[BR] wsun_send_multicast failed rc=%d", rc);
         return -1;
@@ -38,20 +142,253 @@ int br_send_meter_request_from_push3(const uint8_t *payload, uint16_t len)
     return 0;
 }
 
+int br_send_scheduled_meter_request(const uint8_t *payload, uint16_t len,
+                                    const uint8_t (*targets)[16], uint16_t n_targets,
+                                    const uint8_t *schedule, uint16_t *txn_id)
+{
+    if (!payload || len == 0) {
+        LOG_WARN("[BR] empty push3 request");
+        return -1;
+    }
+
+    /* Options that shape the reply (max age, extraction plan): repeated on
+       re-polls, and part of what makes two requests the same */
+    uint8_t shape[BR_RETRY_MAX_OPTS];
+    int shape_len = 0;
+    if (reply_max_age_s) {
+        uint8_t age[2] = { (uint8_t)(reply_max_age_s & 0xFF), (uint8_t)(reply_max_age_s >> 8) };
+        shape_len = meter_opt_put(shape, 0, sizeof(shape), METER_OPT_MAX_AGE, age, sizeof(age));
+    }
+    if (extract_plan_len && shape_len >= 0) {
+        shape_len = meter_opt_put(shape, (uint16_t)shape_len, sizeof(shape), METER_OPT_EXTRACT,
+                                  extract_plan, extract_plan_len);
+    }
+    if (shape_len < 0) {
+        LOG_WARN("[BR] reply options overflow");
+        return -1;
+    }
+
+    br_txn_t *txn = br_txn_open();
+    txn->targeted = (targets && n_targets);
+    txn->req_hash = br_coalesce_hash(payload, len);
+    if (shape_len) {
+        /* Same request under another max age or plan yields other bytes: never coalesce the two */
+        txn->req_hash ^= br_coalesce_hash(shape, (uint16_t)shape_len);
+    }
+    txn->req_len = len;
+    if (txn->targeted) {
+        for (uint16_t i = 0; i < n_targets; i++) {
+            uint16_t node = br_nodes_learn(targets[i]);
+            if (node == BR_NODE_NONE) {
+                LOG_WARN("[BR] node registry full, targeted request refused");
+                br_txn_close(txn->txn_id);
+                return BR_ERR_NO_NODE_SLOT;
+            }
+            br_txn_expect(txn, node);
+        }
+    } else {
+        for (uint16_t i = 0; i < br_nodes_count(); i++) {
+            if (br_nodes_get(i)->flags & BR_NODE_F_ROUTED) br_txn_expect(txn, i);
+        }
+    }
+
+    /* Identical poll already in flight: ride on it instead of another multicast round.
+       The alias has no deadline of its own and completes with its primary. */
+    br_txn_t *primary = schedule ? NULL : br_coalesce_find(txn, payload, shape, (uint8_t)shape_len);
+    if (primary) {
+        txn->primary = primary->txn_id;
+        LOG_INFO("[BR] push3 request coalesced, txn=%u joins txn=%u",
+                 (unsigned)txn->txn_id, (unsigned)primary->txn_id);
+        if (txn_id) *txn_id = txn->txn_id;
+        return 0;
+    }
+
+    /* Options after the target filter are the same for every part of the request */
+    uint8_t tail[METER_HDR_MAX_OPTS];
+    uint16_t expected = n_targets ? n_targets : br_nodes_routed_count();
+    uint16_t slots = (expected && expected < BR_REPLY_MAX_SLOTS) ? expected : BR_REPLY_MAX_SLOTS;
+    uint16_t window_ms = (uint16_t)(slots * BR_REPLY_SLOT_MS);
+    uint8_t window[4] = {
+        (uint8_t)(window_ms & 0xFF), (uint8_t)(window_ms >> 8),
+        (uint8_t)(slots & 0xFF), (uint8_t)(slots >> 8),
+    };
+    int tail_len = meter_opt_put(tail, 0, sizeof(tail), METER_OPT_REPLY_WINDOW, window, sizeof(window));
+    if (schedule) {
+        tail_len = meter_opt_put(tail, (uint16_t)tail_len, sizeof(tail), METER_OPT_SCHEDULE,
+                                 schedule, METER_SCHEDULE_LEN);
+    }
+    if (tail_len >= 0 && (size_t)tail_len + (size_t)shape_len <= sizeof(tail)) {
+        memcpy(&tail[tail_len], shape, (size_t)shape_len);
+        tail_len += shape_len;
+    } else {
+        tail_len = -1;
+    }
+    if (tail_len < 0) {
+        LOG_WARN("[BR] request options overflow, txn=%u", (unsigned)txn->txn_id);
+        br_txn_close(txn->txn_id);
+        return -1;
+    }
+
+    /* One filter stays accurate only up to METER_BLOOM_MAX_TARGETS: larger
+       target sets go out as several requests, each with its own filter */
+    uint16_t parts = 1, per_part = n_targets;
+    if (txn->targeted && n_targets > METER_BLOOM_MAX_TARGETS) {
+        parts = (uint16_t)((n_targets + METER_BLOOM_MAX_TARGETS - 1) / METER_BLOOM_MAX_TARGETS);
+        per_part = (uint16_t)((n_targets + parts - 1) / parts);
+    }
+    LOG_INFO("[BR] push3 -> multicast to NRs, txn=%u len=%u targets=%u parts=%u",
+             (unsigned)txn->txn_id, (unsigned)len, (unsigned)n_targets, (unsigned)parts);
+    for (uint16_t first = 0, part = 0; part < parts; part++, first = (uint16_t)(first + per_part)) {
+        uint16_t n = txn->targeted ? (uint16_t)(n_targets - first < per_part ? n_targets - first : per_part) : 0;
+        if (br_multicast_request(txn->txn_id, n ? &targets[first] : NULL, n,
+                                 tail, (uint8_t)tail_len, payload, len) != 0) {
+            br_txn_close(txn->txn_id);
+            return -1;
+        }
+    }
+    br_retry_store(txn, shape, (uint8_t)shape_len, payload, len);
+    br_txn_arm(txn, (uint32_t)window_ms + BR_TXN_DEADLINE_MARGIN_MS);
+    if (txn_id) *txn_id = txn->txn_id;
+    return 0;
+}
+
+/* End of a transaction: report who answered and who did not to Push3 */
+static void br_txn_done(br_txn_t *txn, br_txn_done_t reason)
+{
+    static uint8_t missing[BR_TXN_NODE_BITMAP];
+    uint16_t n_nodes = br_nodes_count();
+    uint16_t n_missing = 0;
+
+    for (uint16_t i = 0; i < BR_TXN_NODE_BITMAP; i++) {
+        missing[i] = (uint8_t)(txn->expected[i] & ~txn->replied[i]);
+    }
+    for (uint16_t i = 0; i < n_nodes; i++) {
+        if (br_txn_bit(missing, i)) {
+            br_nodes_get(i)->timeouts++;
+            n_missing++;
+        }
+    }
+
+    LOG_INFO("[BR] txn=%u done reason=%u replies=%u missing=%u",
+             (unsigned)txn->txn_id, (unsigned)reason, (unsigned)txn->reply_count, (unsigned)n_missing);
+    push3_report_completion(txn->txn_id, (uint8_t)reason, txn->replied, missing, n_nodes);
+    br_retry_release(txn);
+    if (txn->primary == METER_TXN_NONE) br_coalesce_finish_aliases(txn->txn_id, reason);
+}
+
 /* Called by wsun wrapper when an NR replies to BR.
-   We forward the reply to Push3 (via push3_if) including the NR NodeID (src_ipv6).
+   The sender is resolved to its registry index and the reply header is
+   matched against the correlation table; the payload is then forwarded to
+   Push3 (via push3_if) tagged with the NR's node index.
 */
 void br_handle_nr_reply(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6)
 {
     char ip6str[64];
-    if (src_ipv6) {
-        ipv6_to_str(src_ipv6, ip6str, sizeof(ip6str));
-    } else {
-        snprintf(ip6str, sizeof(ip6str), "(unknown)");
+    meter_hdr_t hdr;
+    if (meter_hdr_decode(payload, len, &hdr) != 0 ||
+        (hdr.type != METER_MSG_REPLY && hdr.type != METER_MSG_REPORT &&
+         hdr.type != METER_MSG_SEGMENT)) {
+        LOG_DEBUG("[BR] Dropping non-reply message len=%u", (unsigned)len);
+        return;
     }
-    LOG_INFO("[BR] Received NR reply from %s len=%u", ip6str, (unsigned)len);
 
-    // For push3 forwarding, create a small message that contains NodeID + payload
-    // Push3 protocol is external — here we call a stub helper that sends NodeID+payload.
-    push3_forward_meter_reply(src_ipv6, payload, len);
+    uint16_t node = br_nodes_learn(src_ipv6);
+    if (node == BR_NODE_NONE) {
+        if (src_ipv6) {
+            ipv6_to_str(src_ipv6, ip6str, sizeof(ip6str));
+        } else {
+            snprintf(ip6str, sizeof(ip6str), "(unknown)");
+        }
+        LOG_WARN("[BR] Reply from unregistered node %s dropped", ip6str);
+        return;
+    }
+    br_node_t *n = br_nodes_get(node);
+    n->flags |= BR_NODE_F_SEEN;
+    n->last_reply_tick = sl_sleeptimer_get_tick_count();
+
+    /* Pieces of a large reply: handled below once br_reasm has all of them */
+    if (hdr.type == METER_MSG_SEGMENT) {
+        br_reasm_on_segment(node, &hdr);
+        return;
+    }
+    br_handle_msg(node, &hdr);
+}
+
+/* A complete REPLY or REPORT from a registered node */
+static void br_handle_msg(uint16_t node, const meter_hdr_t *m)
+{
+    meter_hdr_t hdr = *m;
+    br_node_t *n = br_nodes_get(node);
+
+    /* Delta-coded readings are expanded here; the host always sees meter frames */
+    const uint8_t *data = hdr.payload;
+    uint16_t data_len = hdr.payload_len;
+    int rc = br_delta_unpack(node, hdr.flags, &data, &data_len);
+    if (rc == BR_DELTA_NO_KEY) br_request_keyframe(node, hdr.payload[1]);
+    if (rc != 0) return;
+    uint8_t flags = hdr.flags & (uint8_t)~(METER_F_KEYFRAME | METER_F_DELTA);
+
+    /* Scheduled poll result: no transaction to match, straight to the host */
+    if (hdr.type == METER_MSG_REPORT) {
+        LOG_INFO("[BR] Report from node %u len=%u%s", (unsigned)node, (unsigned)data_len,
+                 (flags & METER_F_HEARTBEAT) ? " (heartbeat)" : "");
+        push3_forward_report(node, flags, data, data_len);
+        return;
+    }
+
+    LOG_INFO("[BR] Received NR reply from node %u txn=%u len=%u",
+             (unsigned)node, (unsigned)hdr.txn_id, (unsigned)data_len);
+
+    /* Targeted poll answered by a node outside the target list: it got
+       through the Bloom filter by a false positive, the host didn't ask */
+    br_txn_t *txn = br_txn_get(hdr.txn_id);
+    if (txn && txn->targeted && !br_txn_bit(txn->expected, node)) {
+        LOG_DEBUG("[BR] Reply txn=%u from untargeted node %u dropped", (unsigned)hdr.txn_id, (unsigned)node);
+        return;
+    }
+
+    switch (br_txn_record_reply(hdr.txn_id, node)) {
+    case BR_TXN_REPLY_FIRST:
+        break;
+    case BR_TXN_REPLY_DUPLICATE:
+        LOG_DEBUG("[BR] Duplicate reply txn=%u from node %u", (unsigned)hdr.txn_id, (unsigned)node);
+        return;
+    case BR_TXN_REPLY_UNKNOWN:
+        LOG_WARN("[BR] Reply for unknown txn=%u from node %u", (unsigned)hdr.txn_id, (unsigned)node);
+        return;
+    }
+
+    n->replies++;
+
+    // For push3 forwarding, create a small message that contains NodeID + flags + payload;
+    // METER_F_EXTRACTED tells the host fields from the whole-frame fallback
+    push3_forward_meter_reply(hdr.txn_id, node, flags, data, data_len);
+    br_coalesce_fanout(hdr.txn_id, node, flags, data, data_len, push3_forward_meter_reply);
+}
+
+void br_set_reply_max_age(uint16_t max_age_s)
+{
+    reply_max_age_s = max_age_s;
+    LOG_INFO("[BR] reply max age %us", (unsigned)max_age_s);
+}
+
+int br_set_extract_plan(const uint8_t *plan, uint8_t len)
+{
+    if (len % METER_EXTRACT_SEL_LEN || len > sizeof(extract_plan)) {
+        LOG_WARN("[BR] bad extraction plan len=%u", (unsigned)len);
+        return -1;
+    }
+    if (len) memcpy(extract_plan, plan, len);
+    extract_plan_len = len;
+    LOG_INFO("[BR] extraction plan %u selectors", (unsigned)(len / METER_EXTRACT_SEL_LEN));
+    return 0;
+}
+
+void br_handler_process(void)
+{
+    br_nodes_process();
+    push3_if_process();
+    br_retry_process();
+    br_reasm_process();
+    br_txn_process();
 }
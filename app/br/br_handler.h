@@ -7,16 +7,62 @@
 extern "C" {
 #endif
 
+/* Request refused: a target could not be entered in the node registry, so
+   it could neither be tracked nor reported missing */
+#define BR_ERR_NO_NODE_SLOT (-2)
+
 /** Initialize BR handler (register callbacks, etc.) */
 void br_handler_init(void);
 
 /**
- * Called by the Push3 interface (or test harness) to request a meter read.
- * The BR will multicast the payload to the NR group and return 0 on successful send.
+ * Called by the Push3 interface (push3_if host commands) to request a meter read.
+ * The BR opens a transaction, multicasts header + payload to the NR group and
+ * returns 0 on successful send. The allocated transaction ID is written to
+ * txn_id (may be NULL); replies are forwarded to Push3 tagged with it.
+ */
+int br_send_meter_request_from_push3(const uint8_t *payload, uint16_t len, uint16_t *txn_id);
+
+/**
+ * Same as br_send_meter_request_from_push3() but only the n_targets NRs listed
+ * in targets (global IPv6 addresses) forward the request to their meter.
+ * The target set is carried as a Bloom filter in the request header (split
+ * over several requests beyond METER_BLOOM_MAX_TARGETS); replies from the
+ * few unaddressed NRs that still answer (false positives) are dropped.
+ * n_targets == 0 polls all.
+ * Returns BR_ERR_NO_NODE_SLOT if a target can't be registered.
+ */
+int br_send_targeted_meter_request(const uint8_t *payload, uint16_t len,
+                                   const uint8_t (*targets)[16], uint16_t n_targets,
+                                   uint16_t *txn_id);
+
+/**
+ * Same as br_send_targeted_meter_request() but also installs a polling
+ * schedule on the addressed NRs: schedule is a METER_OPT_SCHEDULE value
+ * (METER_SCHEDULE_LEN bytes, see meter_proto.h). The NRs then read their
+ * meter with this payload on their own and send REPORTs, which are
+ * forwarded with push3_forward_report(). Such requests are never coalesced.
  */
-int br_send_meter_request_from_push3(const uint8_t *payload, uint16_t len);
+int br_send_scheduled_meter_request(const uint8_t *payload, uint16_t len,
+                                    const uint8_t (*targets)[16], uint16_t n_targets,
+                                    const uint8_t *schedule, uint16_t *txn_id);
+
+/**
+ * Let NRs answer following requests from a cached meter reply up to
+ * max_age_s seconds old (0 = always read the meter).
+ */
+void br_set_reply_max_age(uint16_t max_age_s);
+
+/**
+ * Ask NRs to return only the fields selected by plan (METER_OPT_EXTRACT
+ * selectors) in replies to following requests; len 0 restores whole frames.
+ * Returns 0 on success, -1 if the plan is malformed.
+ */
+int br_set_extract_plan(const uint8_t *plan, uint8_t len);
+
+/** Main-loop service for BR housekeeping (reply batching, ...) */
+void br_handler_process(void);
 
-/** Called by wsun wrapper when an NR unicast reply arrives */
+/** Called by wsun wrapper when an NR unicast reply or report arrives */
 void br_handle_nr_reply(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6);
 
 #ifdef __cplusplus
@@ -0,0 +1,218 @@
+#include "br_nodes.h"
+#include "stack_if.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include <string.h>
+
+#if (BR_NODE_HASH_SLOTS & (BR_NODE_HASH_SLOTS - 1)) != 0
+#error "BR_NODE_HASH_SLOTS must be a power of two"
+#endif
+#if BR_NODE_HASH_SLOTS < 2 * BR_NODE_MAX
+#error "BR_NODE_HASH_SLOTS must be at least 2 * BR_NODE_MAX"
+#endif
+
+/* Nodes are stored densely in registration order so an index is a stable
+   compact node ID. The hash only maps addresses to indices (linear probing).
+   Once the registry is full, the index of a node that has long left the
+   network is given to the newcomer; its hash entry is removed by backward
+   shift so no tombstones build up.
+*/
+static br_node_t nodes[BR_NODE_MAX];
+static uint16_t node_hash_tbl[BR_NODE_HASH_SLOTS];
+static uint16_t node_count = 0;
+static uint16_t routed_count = 0;
+static br_nodes_evict_cb_t g_evict_cb = NULL;
+
+static bool sync_dirty = false;
+static bool sync_done = false;
+static uint32_t last_sync_tick = 0;
+static uint8_t sync_gen = 0;
+
+static uint32_t addr_hash(const uint8_t ipv6[16])
+{
+    /* Only the interface ID differs between nodes of one PAN */
+    uint32_t h = 2166136261u;
+    for (int i = 8; i < 16; i++) {
+        h = (h ^ ipv6[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint32_t uptime_s(void)
+{
+    return (uint32_t)(sl_sleeptimer_get_tick_count64() / sl_sleeptimer_get_timer_frequency());
+}
+
+void br_nodes_init(br_nodes_evict_cb_t evict_cb)
+{
+    g_evict_cb = evict_cb;
+    memset(nodes, 0, sizeof(nodes));
+    memset(node_hash_tbl, 0xFF, sizeof(node_hash_tbl));
+    node_count = 0;
+    routed_count = 0;
+    sync_dirty = true;      // seed from the routing table on first process
+    sync_done = false;
+    sync_gen = 0;
+}
+
+uint16_t br_nodes_lookup(const uint8_t ipv6[16])
+{
+    if (!ipv6) return BR_NODE_NONE;
+    uint32_t mask = BR_NODE_HASH_SLOTS - 1;
+    uint32_t i = addr_hash(ipv6) & mask;
+    for (uint32_t n = 0; n < BR_NODE_HASH_SLOTS; n++, i = (i + 1) & mask) {
+        uint16_t idx = node_hash_tbl[i];
+        if (idx == BR_NODE_NONE) return BR_NODE_NONE;
+        if (memcmp(nodes[idx].ipv6, ipv6, 16) == 0) return idx;
+    }
+    return BR_NODE_NONE;
+}
+
+/* Free idx's hash slot, shifting later entries of the probe run back */
+static void hash_remove(uint16_t idx)
+{
+    uint32_t mask = BR_NODE_HASH_SLOTS - 1;
+    uint32_t i = addr_hash(nodes[idx].ipv6) & mask;
+    while (node_hash_tbl[i] != idx) i = (i + 1) & mask;
+
+    for (uint32_t j = (i + 1) & mask; node_hash_tbl[j] != BR_NODE_NONE; j = (j + 1) & mask) {
+        uint32_t home = addr_hash(nodes[node_hash_tbl[j]].ipv6) & mask;
+        // Entry at j may fill the hole only if its home slot is not in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            node_hash_tbl[i] = node_hash_tbl[j];
+            i = j;
+        }
+    }
+    node_hash_tbl[i] = BR_NODE_NONE;
+}
+
+/* Longest-silent node outside the routing table, silent for BR_NODE_STALE_S */
+static uint16_t stale_victim(uint32_t now)
+{
+    uint16_t victim = BR_NODE_NONE;
+    for (uint16_t i = 0; i < node_count; i++) {
+        const br_node_t *n = &nodes[i];
+        if ((n->flags & BR_NODE_F_ROUTED) || now - n->last_active_s < BR_NODE_STALE_S) continue;
+        if (victim == BR_NODE_NONE || n->last_active_s < nodes[victim].last_active_s) victim = i;
+    }
+    return victim;
+}
+
+uint16_t br_nodes_learn(const uint8_t ipv6[16])
+{
+    if (!ipv6) return BR_NODE_NONE;
+    uint32_t now = uptime_s();
+    uint32_t mask = BR_NODE_HASH_SLOTS - 1;
+    uint32_t i = addr_hash(ipv6) & mask;
+    for (uint32_t n = 0; n < BR_NODE_HASH_SLOTS; n++, i = (i + 1) & mask) {
+        uint16_t idx = node_hash_tbl[i];
+        if (idx == BR_NODE_NONE) break;
+        if (memcmp(nodes[idx].ipv6, ipv6, 16) == 0) {
+            nodes[idx].last_active_s = now;
+            return idx;
+        }
+    }
+
+    uint16_t idx;
+    if (node_count < BR_NODE_MAX) {
+        idx = node_count++;
+    } else {
+        idx = stale_victim(now);
+        if (idx == BR_NODE_NONE) {
+            LOG_WARN("[BR] node registry full (%u)", (unsigned)BR_NODE_MAX);
+            return BR_NODE_NONE;
+        }
+        LOG_INFO("[BR] node %u silent for %lus, index reused", (unsigned)idx,
+                 (unsigned long)(now - nodes[idx].last_active_s));
+        if (g_evict_cb) g_evict_cb(idx);
+        hash_remove(idx);
+        for (uint16_t k = 0; k < node_count; k++) {
+            if (nodes[k].parent == idx) nodes[k].parent = BR_NODE_NONE;
+        }
+        // The removal may have shifted the run: find the free slot again
+        i = addr_hash(ipv6) & mask;
+        while (node_hash_tbl[i] != BR_NODE_NONE) i = (i + 1) & mask;
+    }
+    memset(&nodes[idx], 0, sizeof(nodes[idx]));
+    memcpy(nodes[idx].ipv6, ipv6, 16);
+    nodes[idx].parent = BR_NODE_NONE;
+    nodes[idx].last_active_s = now;
+    node_hash_tbl[i] = idx;
+    return idx;
+}
+
+br_node_t *br_nodes_get(uint16_t idx)
+{
+    return (idx < node_count) ? &nodes[idx] : NULL;
+}
+
+uint16_t br_nodes_count(void)
+{
+    return node_count;
+}
+
+uint16_t br_nodes_routed_count(void)
+{
+    return routed_count;
+}
+
+void br_nodes_mark_dirty(void)
+{
+    sync_dirty = true;
+}
+
+static void merge_route(const uint8_t target[16], const uint8_t parent[16], void *ctx)
+{
+    (void)ctx;
+    uint16_t idx = br_nodes_learn(target);
+    if (idx == BR_NODE_NONE) return;
+    br_node_t *n = &nodes[idx];
+    n->sync_gen = sync_gen;
+    if (!(n->flags & BR_NODE_F_ROUTED)) {
+        n->flags |= BR_NODE_F_ROUTED;
+        routed_count++;
+    }
+}
+
+/* Second pass, once every target has an index: a child listed before its
+   parent would otherwise not find it */
+static void link_parent(const uint8_t target[16], const uint8_t parent[16], void *ctx)
+{
+    (void)ctx;
+    uint16_t idx = br_nodes_lookup(target);
+    if (idx != BR_NODE_NONE) nodes[idx].parent = br_nodes_lookup(parent);
+}
+
+/* Merge the current routing table into the registry. Existing nodes keep
+   their index; only new nodes are inserted and nodes that disappeared lose
+   BR_NODE_F_ROUTED. */
+static void br_nodes_sync(void)
+{
+    sync_gen++;
+    int rc = wsun_br_for_each_route(merge_route, NULL);
+    if (rc < 0) {
+        LOG_WARN("[BR] routing table read failed rc=%d", rc);
+        return;
+    }
+    wsun_br_for_each_route(link_parent, NULL);
+    for (uint16_t i = 0; i < node_count; i++) {
+        if ((nodes[i].flags & BR_NODE_F_ROUTED) && nodes[i].sync_gen != sync_gen) {
+            nodes[i].flags &= (uint8_t)~BR_NODE_F_ROUTED;
+            routed_count--;
+        }
+    }
+    sync_dirty = false;
+    LOG_INFO("[BR] node registry: %u routed, %u known", (unsigned)routed_count, (unsigned)node_count);
+}
+
+void br_nodes_process(void)
+{
+    if (!sync_dirty) return;
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    if (sync_done && (uint32_t)(now - last_sync_tick) < sl_sleeptimer_ms_to_tick(BR_NODE_SYNC_MIN_MS)) {
+        return;
+    }
+    last_sync_tick = now;
+    sync_done = true;
+    br_nodes_sync();
+}
@@ -0,0 +1,81 @@
+#ifndef BR_NODES_H
+#define BR_NODES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Maximum number of NRs the BR keeps track of */
+#ifndef BR_NODE_MAX
+#define BR_NODE_MAX 1024
+#endif
+
+/* Address -> index hash slots; power of two, at least 2x BR_NODE_MAX */
+#ifndef BR_NODE_HASH_SLOTS
+#define BR_NODE_HASH_SLOTS 2048
+#endif
+
+/* A full registry reuses the index of a node that left the routing table
+   and has not been heard of for this long */
+#ifndef BR_NODE_STALE_S
+#define BR_NODE_STALE_S (24UL * 3600UL)
+#endif
+
+/* Minimum time between two routing-table resyncs */
+#ifndef BR_NODE_SYNC_MIN_MS
+#define BR_NODE_SYNC_MIN_MS 5000
+#endif
+
+#define BR_NODE_NONE 0xFFFF
+
+/* Node flags */
+#define BR_NODE_F_ROUTED  0x01   /* present in the last routing table sync */
+#define BR_NODE_F_SEEN    0x02   /* has replied at least once */
+
+typedef struct {
+    uint8_t  ipv6[16];
+    uint16_t parent;            /* index of the preferred parent, BR_NODE_NONE if BR/unknown */
+    uint8_t  flags;
+    uint8_t  sync_gen;          /* last routing table sync that listed this node */
+    uint32_t last_active_s;     /* last time it was looked up, routed or replied (uptime, s) */
+    uint32_t last_reply_tick;
+    uint32_t replies;
+    uint32_t timeouts;
+} br_node_t;
+
+/* An index is about to be given to another node: drop whatever was kept
+   about the old one under it */
+typedef void (*br_nodes_evict_cb_t)(uint16_t idx);
+
+void br_nodes_init(br_nodes_evict_cb_t evict_cb);
+
+/** O(1) lookup of a node index by address; BR_NODE_NONE if unknown */
+uint16_t br_nodes_lookup(const uint8_t ipv6[16]);
+
+/** Lookup, registering the node if it is new. A full registry reuses the index
+    of the longest-silent stale node (BR_NODE_STALE_S); BR_NODE_NONE if there is none. */
+uint16_t br_nodes_learn(const uint8_t ipv6[16]);
+
+/** Per-node state, NULL for an invalid index */
+br_node_t *br_nodes_get(uint16_t idx);
+
+/** Number of registered nodes (indices are 0 .. count-1; reused only once stale) */
+uint16_t br_nodes_count(void);
+
+/** Number of nodes present in the routing table as of the last sync */
+uint16_t br_nodes_routed_count(void);
+
+/** Note that the topology changed; the next br_nodes_process() resyncs */
+void br_nodes_mark_dirty(void);
+
+/** Main-loop service: merges routing table changes (rate limited) */
+void br_nodes_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BR_NODES_H
@@ -0,0 +1,200 @@
+#include "br_reasm.h"
+#include "br_nodes.h"
+#include "stack_if.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SEG_BITMAP_LEN ((METER_SEG_MAX + 7) / 8)
+
+typedef struct {
+    bool     used;
+    uint16_t node;
+    uint16_t txn_id;
+    uint8_t  type;          /* original message type */
+    uint8_t  flags;
+    uint8_t  count;
+    uint8_t  nacks;
+    uint16_t total_len;
+    uint32_t last_tick;     /* last segment received or NACK sent */
+    uint8_t  got[SEG_BITMAP_LEN];
+    uint8_t  buf[METER_DUMP_MAX];
+} br_reasm_t;
+
+/* A reply already delivered; total_len tells a new report (txn 0) apart */
+typedef struct {
+    uint16_t node;
+    uint16_t txn_id;
+    uint16_t total_len;
+    uint32_t done_tick;
+} br_reasm_done_t;
+
+static br_reasm_t pool[BR_REASM_SLOTS];
+static br_reasm_done_t done[BR_REASM_DONE_MAX];
+static uint8_t done_next = 0;
+static br_reasm_done_cb_t g_done_cb = NULL;
+
+void br_reasm_init(br_reasm_done_cb_t done_cb)
+{
+    memset(pool, 0, sizeof(pool));
+    memset(done, 0, sizeof(done));
+    done_next = 0;
+    g_done_cb = done_cb;
+}
+
+static void done_remember(const br_reasm_t *r)
+{
+    br_reasm_done_t *d = &done[done_next];
+    done_next = (uint8_t)((done_next + 1) % BR_REASM_DONE_MAX);
+    d->node = r->node;
+    d->txn_id = r->txn_id;
+    d->total_len = r->total_len;
+    d->done_tick = sl_sleeptimer_get_tick_count();
+}
+
+static bool done_recently(uint16_t node, uint16_t txn_id, uint16_t total_len)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t hold = sl_sleeptimer_ms_to_tick(BR_REASM_DONE_MS);
+    for (int i = 0; i < BR_REASM_DONE_MAX; i++) {
+        const br_reasm_done_t *d = &done[i];
+        if (d->done_tick && d->node == node && d->txn_id == txn_id &&
+            d->total_len == total_len && (uint32_t)(now - d->done_tick) < hold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void send_nack(const br_reasm_t *r, bool complete)
+{
+    br_node_t *n = br_nodes_get(r->node);
+    if (!n) return;
+
+    uint8_t msg[METER_HDR_BASE_LEN + 1 + SEG_BITMAP_LEN];
+    meter_hdr_t hdr = {
+        .type = METER_MSG_SEG_NACK,
+        .txn_id = r->txn_id,
+    };
+    int hlen = meter_hdr_encode(msg, sizeof(msg), &hdr);
+    if (hlen < 0) return;
+
+    uint8_t bm_len = (uint8_t)((r->count + 7) / 8);
+    msg[hlen] = r->count;
+    for (uint8_t i = 0; i < bm_len; i++) {
+        msg[hlen + 1 + i] = complete ? 0 : (uint8_t)~r->got[i];
+    }
+    if (!complete && (r->count & 7)) {
+        msg[hlen + bm_len] &= (uint8_t)((1u << (r->count & 7)) - 1);
+    }
+    wsun_send_unicast(n->ipv6, METER_UDP_PORT, msg, (uint16_t)(hlen + 1 + bm_len));
+}
+
+static br_reasm_t *slot_get(uint16_t node, uint16_t txn_id)
+{
+    br_reasm_t *victim = NULL;
+    for (int i = 0; i < BR_REASM_SLOTS; i++) {
+        br_reasm_t *r = &pool[i];
+        if (r->used && r->node == node && r->txn_id == txn_id) return r;
+        if (!r->used) {
+            if (!victim || victim->used) victim = r;
+        } else if (!victim || (victim->used && (int32_t)(r->last_tick - victim->last_tick) < 0)) {
+            victim = r;
+        }
+    }
+    if (victim->used) {
+        LOG_WARN("[BR] reassembly pool full, dropping txn=%u from node %u",
+                 (unsigned)victim->txn_id, (unsigned)victim->node);
+    }
+    memset(victim, 0, offsetof(br_reasm_t, buf));
+    victim->node = node;
+    victim->txn_id = txn_id;
+    return victim;
+}
+
+void br_reasm_on_segment(uint16_t node, const meter_hdr_t *seg)
+{
+    if (seg->payload_len < METER_SEG_HDR_LEN) return;
+    const uint8_t *p = seg->payload;
+    uint8_t idx = p[1];
+    uint8_t count = p[2];
+    uint16_t total = (uint16_t)(p[3] | (p[4] << 8));
+    uint16_t len = (uint16_t)(seg->payload_len - METER_SEG_HDR_LEN);
+    uint32_t off = (uint32_t)idx * METER_SEG_DATA_MAX;
+
+    if (count == 0 || count > METER_SEG_MAX || idx >= count || total > METER_DUMP_MAX ||
+        count != (total + METER_SEG_DATA_MAX - 1) / METER_SEG_DATA_MAX ||
+        len != ((idx + 1 < count) ? METER_SEG_DATA_MAX : total - off)) {
+        LOG_WARN("[BR] malformed segment from node %u", (unsigned)node);
+        return;
+    }
+
+    /* Late copy of a segment of a reply already delivered: a new slot would
+       only NACK the NR for data it no longer holds */
+    if (done_recently(node, seg->txn_id, total)) {
+        bool open = false;
+        for (int i = 0; i < BR_REASM_SLOTS && !open; i++) {
+            open = pool[i].used && pool[i].node == node && pool[i].txn_id == seg->txn_id;
+        }
+        if (!open) {
+            LOG_DEBUG("[BR] late segment txn=%u from node %u dropped", (unsigned)seg->txn_id, (unsigned)node);
+            return;
+        }
+    }
+
+    br_reasm_t *r = slot_get(node, seg->txn_id);
+    if (!r->used) {
+        r->used = true;
+        r->type = p[0];
+        r->flags = seg->flags;
+        r->count = count;
+        r->total_len = total;
+    } else if (r->count != count || r->total_len != total) {
+        LOG_WARN("[BR] segment txn=%u from node %u disagrees with earlier ones", (unsigned)seg->txn_id, (unsigned)node);
+        return;
+    }
+
+    memcpy(&r->buf[off], &p[METER_SEG_HDR_LEN], len);
+    r->got[idx >> 3] |= (uint8_t)(1u << (idx & 7));
+    r->last_tick = sl_sleeptimer_get_tick_count();
+
+    for (uint8_t i = 0; i < r->count; i++) {
+        if (!(r->got[i >> 3] & (1u << (i & 7)))) return;
+    }
+
+    /* Complete: release the NR's copy, then deliver */
+    send_nack(r, true);
+    r->used = false;
+    done_remember(r);
+    meter_hdr_t hdr = {
+        .type = r->type,
+        .flags = r->flags,
+        .txn_id = r->txn_id,
+        .payload = r->buf,
+        .payload_len = r->total_len,
+    };
+    if (g_done_cb) g_done_cb(node, &hdr);
+}
+
+void br_reasm_process(void)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t gap = sl_sleeptimer_ms_to_tick(BR_REASM_NACK_MS);
+
+    for (int i = 0; i < BR_REASM_SLOTS; i++) {
+        br_reasm_t *r = &pool[i];
+        if (!r->used || (uint32_t)(now - r->last_tick) < gap) continue;
+
+        if (r->nacks >= BR_REASM_MAX_NACKS) {
+            LOG_WARN("[BR] reply txn=%u from node %u incomplete, dropped",
+                     (unsigned)r->txn_id, (unsigned)r->node);
+            r->used = false;
+            continue;
+        }
+        r->nacks++;
+        r->last_tick = now;
+        send_nack(r, false);
+    }
+}
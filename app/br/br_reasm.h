@@ -0,0 +1,55 @@
+#ifndef BR_REASM_H
+#define BR_REASM_H
+
+#include <stdint.h>
+#include "../common/meter_proto.h"
+#include "br_txn.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Segmented replies reassembled at once, one per outstanding poll; the
+   stalest is dropped when full */
+#ifndef BR_REASM_SLOTS
+#define BR_REASM_SLOTS BR_TXN_MAX
+#endif
+
+/* Recently completed replies whose late duplicate segments are dropped, and
+   how long they are remembered (the NR's hold time, NR_METER_SEG_HOLD_MS:
+   past it the NR no longer resends). Reports carry no txn id, so scheduled
+   segmented reports of the same length need to be further apart than this. */
+#ifndef BR_REASM_DONE_MAX
+#define BR_REASM_DONE_MAX 16
+#endif
+#ifndef BR_REASM_DONE_MS
+#define BR_REASM_DONE_MS 5000
+#endif
+
+/* Silence after the last segment before missing ones are NACKed */
+#ifndef BR_REASM_NACK_MS
+#define BR_REASM_NACK_MS 400
+#endif
+
+/* NACK rounds before an incomplete reply is given up */
+#ifndef BR_REASM_MAX_NACKS
+#define BR_REASM_MAX_NACKS 3
+#endif
+
+/* A reply is complete: hdr is the original REPLY/REPORT with the reassembled
+   payload (valid during the call only) */
+typedef void (*br_reasm_done_cb_t)(uint16_t node, const meter_hdr_t *hdr);
+
+void br_reasm_init(br_reasm_done_cb_t done_cb);
+
+/** Feed a decoded SEGMENT message from node */
+void br_reasm_on_segment(uint16_t node, const meter_hdr_t *seg);
+
+/** Main-loop service: NACK gaps, give up on replies that don't complete */
+void br_reasm_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BR_REASM_H
@@ -0,0 +1,152 @@
+#include "br_retry.h"
+#include "br_nodes.h"
+#include "stack_if.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include "../common/meter_proto.h"
+#include <string.h>
+
+/* Per transaction slot: the request to repeat and the re-poll cursor */
+typedef struct {
+    bool     stored;
+    bool     polling;           // a retry round is sending re-polls
+    uint8_t  rounds_left;
+    uint16_t txn_id;
+    uint16_t cursor;            // next node index to consider
+    uint8_t  opts_len;
+    uint8_t  opts[BR_RETRY_MAX_OPTS];
+    uint16_t len;
+    uint8_t  payload[BR_RETRY_MAX_PAYLOAD];
+} br_retry_t;
+
+static br_retry_t retries[BR_TXN_MAX];
+static uint8_t budget = BR_RETRY_MAX_ROUNDS;
+static uint32_t next_send_tick = 0;     // pacing shared by all transactions
+static uint8_t next_slot = 0;           // round-robin start among polling slots
+static uint8_t tx_buf[METER_HDR_BASE_LEN + BR_RETRY_MAX_OPTS + BR_RETRY_MAX_PAYLOAD];
+
+static br_retry_t *slot_of(const br_txn_t *txn)
+{
+    br_retry_t *r = &retries[txn->txn_id % BR_TXN_MAX];
+    return (r->stored && r->txn_id == txn->txn_id) ? r : NULL;
+}
+
+void br_retry_init(void)
+{
+    memset(retries, 0, sizeof(retries));
+    budget = BR_RETRY_MAX_ROUNDS;
+    next_send_tick = sl_sleeptimer_get_tick_count();
+    next_slot = 0;
+}
+
+void br_retry_set_budget(uint8_t rounds)
+{
+    budget = rounds;
+}
+
+void br_retry_store(const br_txn_t *txn, const uint8_t *opts, uint8_t opts_len,
+                    const uint8_t *payload, uint16_t len)
+{
+    br_retry_t *r = &retries[txn->txn_id % BR_TXN_MAX];
+    r->stored = false;
+    if (len > sizeof(r->payload) || opts_len > sizeof(r->opts)) return;
+
+    if (opts_len) memcpy(r->opts, opts, opts_len);
+    r->opts_len = opts_len;
+    memcpy(r->payload, payload, len);
+    r->len = len;
+    r->txn_id = txn->txn_id;
+    r->rounds_left = budget;
+    r->polling = false;
+    r->stored = true;
+}
+
+bool br_retry_same_request(const br_txn_t *txn, const uint8_t *opts, uint8_t opts_len,
+                           const uint8_t *payload, uint16_t len)
+{
+    const br_retry_t *r = slot_of(txn);
+    return r && r->opts_len == opts_len && r->len == len &&
+           memcmp(r->opts, opts, opts_len) == 0 && memcmp(r->payload, payload, len) == 0;
+}
+
+bool br_retry_on_expiry(br_txn_t *txn)
+{
+    br_retry_t *r = slot_of(txn);
+    if (!r || r->rounds_left == 0) return false;
+
+    r->rounds_left--;
+    r->polling = true;
+    r->cursor = 0;
+    LOG_INFO("[BR] txn=%u re-polling %u missing nodes, %u rounds left",
+             (unsigned)txn->txn_id, (unsigned)(txn->expected_count - txn->expected_replied),
+             (unsigned)r->rounds_left);
+    return true;
+}
+
+void br_retry_release(const br_txn_t *txn)
+{
+    br_retry_t *r = slot_of(txn);
+    if (r) r->stored = false;
+}
+
+/* Unicast the stored request to one node; no target filter or reply window,
+   only the options that shape the reply itself */
+static void br_retry_send(const br_retry_t *r, const br_node_t *node)
+{
+    meter_hdr_t hdr = {
+        .type = METER_MSG_REQUEST,
+        .txn_id = r->txn_id,
+        .opts = r->opts,
+        .opts_len = r->opts_len,
+    };
+    int hlen = meter_hdr_encode(tx_buf, sizeof(tx_buf), &hdr);
+    if (hlen < 0) return;
+    memcpy(&tx_buf[hlen], r->payload, r->len);
+
+    int rc = wsun_send_unicast(node->ipv6, METER_UDP_PORT, tx_buf, (uint16_t)(hlen + r->len));
+    if (rc != 0) {
+        LOG_WARN("[BR] re-poll txn=%u failed rc=%d", (unsigned)r->txn_id, rc);
+    }
+}
+
+void br_retry_process(void)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    if ((int32_t)(now - next_send_tick) < 0) return;
+
+    /* One re-poll per pace interval across all transactions, taking turns
+       so concurrent rounds share the air instead of multiplying it */
+    for (int k = 0; k < BR_TXN_MAX; k++) {
+        uint8_t i = (uint8_t)((next_slot + k) % BR_TXN_MAX);
+        br_retry_t *r = &retries[i];
+        if (!r->stored || !r->polling) continue;
+
+        br_txn_t *txn = br_txn_get(r->txn_id);
+        if (!txn) {
+            r->stored = false;
+            continue;
+        }
+
+        /* Next missing node from the cursor */
+        bool sent = false;
+        uint16_t n = br_nodes_count();
+        while (r->cursor < n) {
+            uint16_t idx = r->cursor++;
+            if (br_txn_bit(txn->expected, idx) && !br_txn_bit(txn->replied, idx)) {
+                br_retry_send(r, br_nodes_get(idx));
+                sent = true;
+                break;
+            }
+        }
+
+        if (r->cursor >= n) {
+            r->polling = false;
+            br_txn_arm(txn, BR_RETRY_DEADLINE_MS);
+        }
+        if (sent) {
+            next_send_tick = now + sl_sleeptimer_ms_to_tick(BR_RETRY_PACE_MS);
+            next_slot = (uint8_t)((i + 1) % BR_TXN_MAX);
+            return;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef BR_RETRY_H
+#define BR_RETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "br_txn.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Unicast re-poll rounds allowed per transaction after the first deadline */
+#ifndef BR_RETRY_MAX_ROUNDS
+#define BR_RETRY_MAX_ROUNDS 2
+#endif
+
+/* Gap between two unicast re-polls, whichever transactions they belong
+   to, so they do not collide near the BR */
+#ifndef BR_RETRY_PACE_MS
+#define BR_RETRY_PACE_MS 50
+#endif
+
+/* Deadline of a retry round, counted from its last re-poll */
+#ifndef BR_RETRY_DEADLINE_MS
+#define BR_RETRY_DEADLINE_MS 3000
+#endif
+
+/* Largest Push3 payload kept for re-polling */
+#ifndef BR_RETRY_MAX_PAYLOAD
+#define BR_RETRY_MAX_PAYLOAD 512
+#endif
+
+/* Reply-shaping options (max age, extraction plan) repeated on re-polls */
+#ifndef BR_RETRY_MAX_OPTS
+#define BR_RETRY_MAX_OPTS 72
+#endif
+
+void br_retry_init(void);
+
+/** Change the number of retry rounds for transactions opened from now on */
+void br_retry_set_budget(uint8_t rounds);
+
+/** Keep a copy of the request payload and its reply-shaping options for later
+    re-polls (and request matching, so it is kept even with no retry budget) */
+void br_retry_store(const br_txn_t *txn, const uint8_t *opts, uint8_t opts_len,
+                    const uint8_t *payload, uint16_t len);
+
+/** txn's stored request has exactly these options and payload */
+bool br_retry_same_request(const br_txn_t *txn, const uint8_t *opts, uint8_t opts_len,
+                           const uint8_t *payload, uint16_t len);
+
+/**
+ * br_txn expiry hook: if budget is left, start a round of paced unicast
+ * re-polls to the expected nodes that have not replied and return true.
+ */
+bool br_retry_on_expiry(br_txn_t *txn);
+
+/** Forget the stored request of a finished transaction */
+void br_retry_release(const br_txn_t *txn);
+
+/** Main-loop service: sends due re-polls and re-arms deadlines */
+void br_retry_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BR_RETRY_H
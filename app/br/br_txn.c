@@ -0,0 +1,146 @@
+#include "br_txn.h"
+#include "log.h"
+#include "../common/meter_proto.h"
+#include <string.h>
+
+static br_txn_t txns[BR_TXN_MAX];
+static uint16_t next_txn_id = 1;
+static uint32_t open_seq = 0;
+static br_txn_done_cb_t g_done_cb = NULL;
+static br_txn_expiry_cb_t g_expiry_cb = NULL;
+
+static void txn_reset(br_txn_t *t, uint16_t id)
+{
+    t->in_use = true;
+    t->expired = false;
+    t->targeted = false;
+    t->txn_id = id;
+    t->primary = METER_TXN_NONE;
+    t->req_len = 0;
+    t->req_hash = 0;
+    t->open_tick = sl_sleeptimer_get_tick_count();
+    t->reply_count = 0;
+    t->expected_count = 0;
+    t->expected_replied = 0;
+    t->open_seq = open_seq++;
+    memset(t->expected, 0, sizeof(t->expected));
+    memset(t->replied, 0, sizeof(t->replied));
+}
+
+static void txn_deadline_cb(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+    (void)handle;
+    ((br_txn_t *)data)->expired = true;
+}
+
+void br_txn_finish(br_txn_t *t, br_txn_done_t reason)
+{
+    if (g_done_cb) g_done_cb(t, reason);
+    br_txn_close(t->txn_id);
+}
+
+void br_txn_init(br_txn_done_cb_t done_cb, br_txn_expiry_cb_t expiry_cb)
+{
+    g_done_cb = done_cb;
+    g_expiry_cb = expiry_cb;
+    memset(txns, 0, sizeof(txns));
+    next_txn_id = 1;
+    open_seq = 0;
+}
+
+br_txn_t *br_txn_open(void)
+{
+    /* Advance the ID counter until it lands on a free slot (at most BR_TXN_MAX tries) */
+    for (int tries = 0; tries < BR_TXN_MAX; tries++) {
+        uint16_t id = next_txn_id++;
+        if (next_txn_id == METER_TXN_NONE) next_txn_id = 1;
+        br_txn_t *t = &txns[id % BR_TXN_MAX];
+        if (!t->in_use) {
+            txn_reset(t, id);
+            return t;
+        }
+    }
+
+    /* Table full: reclaim the oldest outstanding transaction */
+    br_txn_t *oldest = &txns[0];
+    for (int i = 1; i < BR_TXN_MAX; i++) {
+        if ((int32_t)(txns[i].open_seq - oldest->open_seq) < 0) oldest = &txns[i];
+    }
+    LOG_WARN("[BR] txn table full, dropping txn %u (%u replies)",
+             (unsigned)oldest->txn_id, (unsigned)oldest->reply_count);
+    br_txn_finish(oldest, BR_TXN_DONE_EVICTED);
+
+    /* Reuse the freed slot with an ID that maps to it */
+    uint16_t slot = (uint16_t)(oldest - txns);
+    uint16_t id = next_txn_id;
+    while ((id % BR_TXN_MAX) != slot || id == METER_TXN_NONE) id++;
+    next_txn_id = (uint16_t)(id + 1);
+    if (next_txn_id == METER_TXN_NONE) next_txn_id = 1;
+
+    txn_reset(oldest, id);
+    return oldest;
+}
+
+void br_txn_expect(br_txn_t *txn, uint16_t node)
+{
+    if (node >= BR_NODE_MAX || br_txn_bit(txn->expected, node)) return;
+    txn->expected[node >> 3] |= (uint8_t)(1u << (node & 7));
+    txn->expected_count++;
+}
+
+void br_txn_arm(br_txn_t *txn, uint32_t timeout_ms)
+{
+    sl_status_t rc = sl_sleeptimer_start_timer(&txn->timer, sl_sleeptimer_ms_to_tick(timeout_ms),
+                                               txn_deadline_cb, txn, 0, 0);
+    if (rc != SL_STATUS_OK) {
+        LOG_WARN("[BR] txn %u deadline timer failed rc=0x%lx", (unsigned)txn->txn_id, (unsigned long)rc);
+        txn->expired = true;
+    }
+}
+
+br_txn_t *br_txn_get(uint16_t txn_id)
+{
+    if (txn_id == METER_TXN_NONE) return NULL;
+    br_txn_t *t = &txns[txn_id % BR_TXN_MAX];
+    return (t->in_use && t->txn_id == txn_id) ? t : NULL;
+}
+
+br_txn_t *br_txn_get_slot(uint16_t slot)
+{
+    return (slot < BR_TXN_MAX && txns[slot].in_use) ? &txns[slot] : NULL;
+}
+
+br_txn_reply_t br_txn_record_reply(uint16_t txn_id, uint16_t node)
+{
+    br_txn_t *t = br_txn_get(txn_id);
+    if (!t || node >= BR_NODE_MAX) return BR_TXN_REPLY_UNKNOWN;
+    if (br_txn_bit(t->replied, node)) return BR_TXN_REPLY_DUPLICATE;
+
+    t->replied[node >> 3] |= (uint8_t)(1u << (node & 7));
+    t->reply_count++;
+    if (br_txn_bit(t->expected, node)) t->expected_replied++;
+    return BR_TXN_REPLY_FIRST;
+}
+
+void br_txn_close(uint16_t txn_id)
+{
+    br_txn_t *t = br_txn_get(txn_id);
+    if (!t) return;
+
+    sl_sleeptimer_stop_timer(&t->timer);
+    t->in_use = false;
+}
+
+void br_txn_process(void)
+{
+    for (int i = 0; i < BR_TXN_MAX; i++) {
+        br_txn_t *t = &txns[i];
+        if (!t->in_use) continue;
+        if (t->expected_count && t->expected_replied >= t->expected_count) {
+            br_txn_finish(t, BR_TXN_DONE_COMPLETE);
+        } else if (t->expired) {
+            t->expired = false;
+            if (!g_expiry_cb || !g_expiry_cb(t)) br_txn_finish(t, BR_TXN_DONE_TIMEOUT);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef BR_TXN_H
+#define BR_TXN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sl_sleeptimer.h"
+#include "br_nodes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of Push3 polls that may be outstanding at the same time */
+#ifndef BR_TXN_MAX
+#define BR_TXN_MAX 8
+#endif
+
+/* One bit per registry node index */
+#define BR_TXN_NODE_BITMAP ((BR_NODE_MAX + 7) / 8)
+
+typedef struct {
+    bool     in_use;
+    volatile bool expired;  /* set by the deadline timer (interrupt context) */
+    bool     targeted;      /* expected set came from an explicit target list */
+    uint16_t txn_id;
+    uint16_t primary;       /* txn this one is coalesced onto, METER_TXN_NONE if it went on air */
+    uint16_t req_len;
+    uint32_t req_hash;      /* hash of the Push3 payload, for coalescing */
+    uint32_t open_tick;
+    uint16_t reply_count;
+    uint16_t expected_count;
+    uint16_t expected_replied;
+    uint32_t open_seq;      /* allocation order, used to reclaim the oldest slot */
+    uint8_t  expected[BR_TXN_NODE_BITMAP];
+    uint8_t  replied[BR_TXN_NODE_BITMAP];
+    sl_sleeptimer_timer_handle_t timer;
+} br_txn_t;
+
+typedef enum {
+    BR_TXN_DONE_COMPLETE = 0,     /* every expected node answered */
+    BR_TXN_DONE_TIMEOUT  = 1,     /* deadline reached */
+    BR_TXN_DONE_EVICTED  = 2,     /* slot reclaimed for a newer transaction */
+} br_txn_done_t;
+
+/* Called once per transaction right before it is released */
+typedef void (*br_txn_done_cb_t)(br_txn_t *txn, br_txn_done_t reason);
+
+/* Called when the deadline fires with expected nodes still missing.
+   Return true if the txn was kept open (e.g. a retry round was started and
+   will re-arm the deadline), false to complete it as BR_TXN_DONE_TIMEOUT. */
+typedef bool (*br_txn_expiry_cb_t)(br_txn_t *txn);
+
+typedef enum {
+    BR_TXN_REPLY_FIRST     = 0,   /* first reply from this node for this txn */
+    BR_TXN_REPLY_DUPLICATE = 1,   /* node already answered this txn */
+    BR_TXN_REPLY_UNKNOWN   = -1,  /* txn not outstanding (late or stray reply) */
+} br_txn_reply_t;
+
+void br_txn_init(br_txn_done_cb_t done_cb, br_txn_expiry_cb_t expiry_cb);
+
+/**
+ * Allocate a new transaction. If all BR_TXN_MAX slots are busy the oldest
+ * transaction is completed as BR_TXN_DONE_EVICTED to make room. Never returns NULL.
+ */
+br_txn_t *br_txn_open(void);
+
+/** Add a node (registry index) to the set whose replies complete the txn */
+void br_txn_expect(br_txn_t *txn, uint16_t node);
+
+/** Start the deadline; the txn completes as BR_TXN_DONE_TIMEOUT after timeout_ms */
+void br_txn_arm(br_txn_t *txn, uint32_t timeout_ms);
+
+static inline bool br_txn_bit(const uint8_t *bm, uint16_t node)
+{
+    return node < BR_NODE_MAX && (bm[node >> 3] & (1u << (node & 7)));
+}
+
+/** O(1) lookup of an outstanding transaction, NULL if not open */
+br_txn_t *br_txn_get(uint16_t txn_id);
+
+/** Open transaction in table slot 0 .. BR_TXN_MAX-1, NULL if the slot is free */
+br_txn_t *br_txn_get_slot(uint16_t slot);
+
+/** Record a reply from node (br_nodes index) against txn_id; O(1), duplicates
+    are found in the txn's replied bitmap */
+br_txn_reply_t br_txn_record_reply(uint16_t txn_id, uint16_t node);
+
+/** Complete the transaction now: completion callback, then release */
+void br_txn_finish(br_txn_t *txn, br_txn_done_t reason);
+
+/** Release the transaction (no completion callback) */
+void br_txn_close(uint16_t txn_id);
+
+/** Main-loop service: completes transactions that finished or hit their deadline */
+void br_txn_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BR_TXN_H
@@ -1,17 +1,357 @@
 #include "push3_if.h"
+#include "push3_link.h"
+#include "br_handler.h"
+#include "br_nodes.h"
+#include "br_txn.h"
+#include "../common/meter_proto.h"
 #include "log.h"
-#include <stdio.h>
 #include <string.h>
-#include "../common/ipv6_utils.h"
+#include <stdbool.h>
+#include "sl_sleeptimer.h"
 
-void push3_forward_meter_reply(const uint8_t *node_ipv6, const uint8_t *payload, uint16_t len)
+#if PUSH3_BATCH_MAX > PUSH3_LINK_MAX_PAYLOAD
+#error "PUSH3_BATCH_MAX exceeds the host-link frame payload"
+#endif
+
+/* Batch record kinds */
+#define PUSH3_REC_REPLY 0x01    /* [kind][txn LE16][node LE16][flags][len LE16][payload] */
+#define PUSH3_REC_NODE  0x02    /* [kind][node LE16][IPv6 16] */
+#define PUSH3_REC_REPORT 0x03   /* [kind][node LE16][flags][len LE16][payload] */
+#define PUSH3_REC_REPLY_HDR_LEN  8
+#define PUSH3_REC_NODE_LEN       19
+#define PUSH3_REC_REPORT_HDR_LEN 6
+
+#define PUSH3_COMPLETION_HDR_LEN 5
+
+static uint8_t batch_buf[PUSH3_BATCH_MAX];
+static uint16_t batch_len = 0;
+static uint16_t batch_count = 0;
+static uint32_t batch_first_tick = 0;
+static uint32_t latency_ticks = 0;
+static bool batch_stuck = false;    // last send found the UART full; retried from push3_if_process
+
+/* Nodes whose index -> address mapping the host has already been sent */
+static uint8_t announced[(BR_NODE_MAX + 7) / 8];
+
+/* ACK and COMPLETION frames waiting for the UART, sent in order. A
+   completion also waits for the batch holding its transaction's replies. */
+typedef struct {
+    uint8_t type;
+    uint16_t len;
+    uint8_t data[PUSH3_COMPLETION_HDR_LEN + 2 * BR_TXN_NODE_BITMAP];
+} push3_pending_t;
+
+static push3_pending_t pending[PUSH3_PENDING_MAX];
+static uint8_t pending_head = 0;
+static uint8_t pending_count = 0;
+
+/* Send the batch; on a full UART it is kept whole for the next attempt */
+static bool batch_send(void)
+{
+    if (batch_count == 0) return true;
+    push3_span_t span = { batch_buf, batch_len };
+    if (push3_link_send(PUSH3_FRAME_REPLY_BATCH, &span, 1) < 0) {
+        if (!batch_stuck) {
+            LOG_WARN("[Push3 IF] batch of %u records (%u bytes) deferred, UART busy",
+                     (unsigned)batch_count, (unsigned)batch_len);
+        }
+        batch_stuck = true;
+        return false;
+    }
+    batch_len = 0;
+    batch_count = 0;
+    batch_stuck = false;
+    return true;
+}
+
+/* True once rec_len bytes fit at the end of the batch, sending it first if needed */
+static bool batch_room(uint16_t rec_len)
+{
+    if (batch_len + rec_len <= sizeof(batch_buf)) return true;
+    return batch_send() && rec_len <= sizeof(batch_buf);
+}
+
+/* Caller has checked batch_room(rec_len) */
+static uint8_t *batch_reserve(uint16_t rec_len)
+{
+    if (batch_count == 0) batch_first_tick = sl_sleeptimer_get_tick_count();
+    uint8_t *p = &batch_buf[batch_len];
+    batch_len = (uint16_t)(batch_len + rec_len);
+    batch_count++;
+    return p;
+}
+
+static bool push3_announced(uint16_t node)
+{
+    return (announced[node >> 3] & (1u << (node & 7))) != 0;
+}
+
+/* Queue the node's address record unless the host has it. A node is only
+   marked announced once its record is in the batch. */
+static bool push3_announce_node(uint16_t node)
+{
+    br_node_t *n = br_nodes_get(node);
+    if (!n || push3_announced(node)) return true;
+    if (!batch_room(PUSH3_REC_NODE_LEN)) return false;
+    announced[node >> 3] |= (uint8_t)(1u << (node & 7));
+
+    uint8_t *p = batch_reserve(PUSH3_REC_NODE_LEN);
+    p[0] = PUSH3_REC_NODE;
+    p[1] = (uint8_t)(node & 0xFF);
+    p[2] = (uint8_t)(node >> 8);
+    memcpy(&p[3], n->ipv6, 16);
+    return true;
+}
+
+/* Room for a record from node, plus its address record if not yet announced */
+static bool push3_record_room(uint16_t node, uint16_t rec_len)
+{
+    uint16_t need = rec_len;
+    if (br_nodes_get(node) && !push3_announced(node)) need = (uint16_t)(need + PUSH3_REC_NODE_LEN);
+    return batch_room(need);
+}
+
+/* Everything a queued completion needs before it can go out */
+static bool push3_completion_ready(const push3_pending_t *e)
+{
+    uint16_t n_nodes = (uint16_t)(e->data[3] | (e->data[4] << 8));
+    const uint8_t *missing = &e->data[PUSH3_COMPLETION_HDR_LEN + (n_nodes + 7) / 8];
+
+    /* The host must be able to name every node it is told about */
+    for (uint16_t i = 0; i < n_nodes; i++) {
+        if ((missing[i >> 3] & (1u << (i & 7))) && !push3_announce_node(i)) return false;
+    }
+    return batch_send();
+}
+
+static void push3_pending_drain(void)
+{
+    while (pending_count) {
+        const push3_pending_t *e = &pending[pending_head];
+        if (e->type == PUSH3_FRAME_COMPLETION && !push3_completion_ready(e)) return;
+
+        push3_span_t span = { e->data, e->len };
+        if (push3_link_send(e->type, &span, 1) < 0) return;
+        pending_head = (uint8_t)((pending_head + 1) % PUSH3_PENDING_MAX);
+        pending_count--;
+    }
+}
+
+static void push3_pending_push(uint8_t type, const push3_span_t *spans, uint8_t n_spans)
+{
+    if (pending_count == PUSH3_PENDING_MAX) {
+        LOG_ERROR("[Push3 IF] control frame queue full, frame type %u dropped", (unsigned)type);
+        return;
+    }
+    push3_pending_t *e = &pending[(pending_head + pending_count) % PUSH3_PENDING_MAX];
+    e->type = type;
+    e->len = 0;
+    for (uint8_t i = 0; i < n_spans; i++) {
+        memcpy(&e->data[e->len], spans[i].data, spans[i].len);
+        e->len = (uint16_t)(e->len + spans[i].len);
+    }
+    pending_count++;
+    push3_pending_drain();
+}
+
+static void push3_ack(uint8_t seq, uint8_t status, uint16_t txn_id)
+{
+    uint8_t ack[4] = { seq, status, (uint8_t)(txn_id & 0xFF), (uint8_t)(txn_id >> 8) };
+    push3_span_t span = { ack, sizeof(ack) };
+    push3_pending_push(PUSH3_FRAME_ACK, &span, 1);
+}
+
+/* Host command dispatch. Payloads are passed to br_handler in place. */
+static void push3_rx_cmd(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len)
+{
+    uint16_t txn_id = 0;
+    int rc;
+
+    switch (type) {
+    case PUSH3_CMD_METER_REQUEST:
+        rc = br_send_meter_request_from_push3(payload, len, &txn_id);
+        break;
+
+    case PUSH3_CMD_TARGETED_REQUEST: {
+        if (len < 2) {
+            push3_ack(seq, PUSH3_STATUS_BAD_ARGS, 0);
+            return;
+        }
+        uint16_t n = (uint16_t)(payload[0] | (payload[1] << 8));
+        uint32_t tlen = 2 + (uint32_t)n * 16;
+        if (tlen >= len) {
+            push3_ack(seq, PUSH3_STATUS_BAD_ARGS, 0);
+            return;
+        }
+        rc = br_send_targeted_meter_request(&payload[tlen], (uint16_t)(len - tlen),
+                                            (const uint8_t (*)[16])&payload[2], n, &txn_id);
+        break;
+    }
+
+    case PUSH3_CMD_SCHEDULE_REQUEST: {
+        if (len < METER_SCHEDULE_LEN + 2) {
+            push3_ack(seq, PUSH3_STATUS_BAD_ARGS, 0);
+            return;
+        }
+        const uint8_t *t = &payload[METER_SCHEDULE_LEN];
+        uint16_t n = (uint16_t)(t[0] | (t[1] << 8));
+        uint32_t tlen = METER_SCHEDULE_LEN + 2 + (uint32_t)n * 16;
+        if (tlen >= len) {
+            push3_ack(seq, PUSH3_STATUS_BAD_ARGS, 0);
+            return;
+        }
+        rc = br_send_scheduled_meter_request(&payload[tlen], (uint16_t)(len - tlen),
+                                             (const uint8_t (*)[16])&t[2], n, payload, &txn_id);
+        break;
+    }
+
+    case PUSH3_CMD_SET_MAX_AGE:
+        if (len != 2) {
+            push3_ack(seq, PUSH3_STATUS_BAD_ARGS, 0);
+            return;
+        }
+        br_set_reply_max_age((uint16_t)(payload[0] | (payload[1] << 8)));
+        rc = 0;
+        break;
+
+    case PUSH3_CMD_RESYNC:
+        /* New host session: it knows no node yet, announce each again on first use */
+        memset(announced, 0, sizeof(announced));
+        LOG_INFO("[Push3 IF] host resync");
+        rc = 0;
+        break;
+
+    case PUSH3_CMD_SET_EXTRACT:
+        if (len > 0xFF || br_set_extract_plan(payload, (uint8_t)len) != 0) {
+            push3_ack(seq, PUSH3_STATUS_BAD_ARGS, 0);
+            return;
+        }
+        rc = 0;
+        break;
+
+    default:
+        LOG_WARN("[Push3 IF] unknown command 0x%02X seq=%u", (unsigned)type, (unsigned)seq);
+        push3_ack(seq, PUSH3_STATUS_UNKNOWN_CMD, 0);
+        return;
+    }
+
+    push3_ack(seq, rc == 0 ? PUSH3_STATUS_OK :
+                   rc == BR_ERR_NO_NODE_SLOT ? PUSH3_STATUS_NO_NODE_SLOT : PUSH3_STATUS_SEND_FAILED,
+              txn_id);
+}
+
+void push3_if_init(void)
+{
+    push3_link_init(push3_rx_cmd);
+    batch_len = 0;
+    batch_count = 0;
+    batch_stuck = false;
+    pending_head = 0;
+    pending_count = 0;
+    memset(announced, 0, sizeof(announced));
+    push3_set_latency_budget_ms(PUSH3_BATCH_LATENCY_MS);
+}
+
+void push3_set_latency_budget_ms(uint32_t ms)
+{
+    latency_ticks = sl_sleeptimer_ms_to_tick(ms);
+    if (latency_ticks == 0) push3_flush();
+}
+
+void push3_flush(void)
+{
+    if (batch_count == 0) return;
+    LOG_DEBUG("[Push3 IF] Flushing batch count=%u len=%u", (unsigned)batch_count, (unsigned)batch_len);
+    batch_send();
+}
+
+void push3_forget_node(uint16_t node)
+{
+    if (node < BR_NODE_MAX) announced[node >> 3] &= (uint8_t)~(1u << (node & 7));
+}
+
+void push3_forward_meter_reply(uint16_t txn_id, uint16_t node, uint8_t flags,
+                               const uint8_t *payload, uint16_t len)
+{
+    uint32_t rec_len = PUSH3_REC_REPLY_HDR_LEN + (uint32_t)len;
+    LOG_DEBUG("[Push3 IF] Queue reply txn=%u len=%u", (unsigned)txn_id, (unsigned)len);
+
+    if (rec_len + PUSH3_REC_NODE_LEN > sizeof(batch_buf)) {
+        LOG_WARN("[Push3 IF] Reply txn=%u len=%u exceeds batch frame, dropped", (unsigned)txn_id, (unsigned)len);
+        return;
+    }
+
+    if (!push3_record_room(node, (uint16_t)rec_len)) {
+        LOG_ERROR("[Push3 IF] Reply txn=%u from node %u dropped, host link backed up", (unsigned)txn_id, (unsigned)node);
+        return;
+    }
+    push3_announce_node(node);
+    uint8_t *p = batch_reserve((uint16_t)rec_len);
+    p[0] = PUSH3_REC_REPLY;
+    p[1] = (uint8_t)(txn_id & 0xFF);
+    p[2] = (uint8_t)(txn_id >> 8);
+    p[3] = (uint8_t)(node & 0xFF);
+    p[4] = (uint8_t)(node >> 8);
+    p[5] = flags;
+    p[6] = (uint8_t)(len & 0xFF);
+    p[7] = (uint8_t)(len >> 8);
+    memcpy(&p[PUSH3_REC_REPLY_HDR_LEN], payload, len);
+
+    if (latency_ticks == 0) push3_flush();
+}
+
+void push3_forward_report(uint16_t node, uint8_t flags, const uint8_t *payload, uint16_t len)
+{
+    uint32_t rec_len = PUSH3_REC_REPORT_HDR_LEN + (uint32_t)len;
+    if (rec_len + PUSH3_REC_NODE_LEN > sizeof(batch_buf)) {
+        LOG_WARN("[Push3 IF] Report from node %u len=%u exceeds batch frame, dropped", (unsigned)node, (unsigned)len);
+        return;
+    }
+
+    if (!push3_record_room(node, (uint16_t)rec_len)) {
+        LOG_ERROR("[Push3 IF] Report from node %u dropped, host link backed up", (unsigned)node);
+        return;
+    }
+    push3_announce_node(node);
+    uint8_t *p = batch_reserve((uint16_t)rec_len);
+    p[0] = PUSH3_REC_REPORT;
+    p[1] = (uint8_t)(node & 0xFF);
+    p[2] = (uint8_t)(node >> 8);
+    p[3] = flags;
+    p[4] = (uint8_t)(len & 0xFF);
+    p[5] = (uint8_t)(len >> 8);
+    memcpy(&p[PUSH3_REC_REPORT_HDR_LEN], payload, len);
+
+    if (latency_ticks == 0) push3_flush();
+}
+
+void push3_report_completion(uint16_t txn_id, uint8_t reason,
+                             const uint8_t *replied, const uint8_t *missing, uint16_t n_nodes)
+{
+    if (n_nodes > BR_NODE_MAX) n_nodes = BR_NODE_MAX;
+    uint16_t bm_len = (uint16_t)((n_nodes + 7) / 8);
+
+    uint8_t hdr[PUSH3_COMPLETION_HDR_LEN] = {
+        (uint8_t)(txn_id & 0xFF), (uint8_t)(txn_id >> 8), reason,
+        (uint8_t)(n_nodes & 0xFF), (uint8_t)(n_nodes >> 8),
+    };
+    push3_span_t spans[3] = {
+        { hdr, sizeof(hdr) },
+        { replied, bm_len },
+        { missing, bm_len },
+    };
+    /* Queued behind earlier control frames; goes out once its missing
+       nodes are announced and the batch ahead of it has been sent */
+    push3_pending_push(PUSH3_FRAME_COMPLETION, spans, 3);
+}
+
+void push3_if_process(void)
 {
-    char ip6[64] = {0};
-    if (node_ipv6) ipv6_to_str(node_ipv6, ip6, sizeof(ip6));
-    LOG_INFO("[Push3 IF] Forwarding reply from %s len=%u", ip6, (unsigned)len);
+    push3_link_poll();
+    push3_pending_drain();
 
-    // For now print to console for debugging
-    printf("PUSH3_REPLY Node=%s PayloadLen=%u DataHex=", ip6, (unsigned)len);
-    for (uint16_t i=0;i<len;i++) printf("%02X", payload[i]);
-    printf("\n");
+    if (batch_count == 0) return;
+    if (batch_stuck || (uint32_t)(sl_sleeptimer_get_tick_count() - batch_first_tick) >= latency_ticks) {
+        push3_flush();
+    }
 }
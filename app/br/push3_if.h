@@ -7,10 +7,67 @@
 extern "C" {
 #endif
 
-/* Forward a meter reply (with NodeID) to Push3 host.
-   In your real system this would send to the BR host link (UART/RS485/USB).
+/* Host-link frame capacity used to aggregate NR replies.
+   Must hold at least one full NR reply plus its record header and must not
+   exceed PUSH3_LINK_MAX_PAYLOAD. */
+#ifndef PUSH3_BATCH_MAX
+#define PUSH3_BATCH_MAX 2304
+#endif
+
+/* Default time a reply may wait in the batch before it is flushed */
+#ifndef PUSH3_BATCH_LATENCY_MS
+#define PUSH3_BATCH_LATENCY_MS 20
+#endif
+
+/* ACK and COMPLETION frames held while the UART is backed up */
+#ifndef PUSH3_PENDING_MAX
+#define PUSH3_PENDING_MAX 8
+#endif
+
+/* Host commands (PUSH3_CMD_*) received on the link are dispatched to
+   br_handler and answered with a PUSH3_FRAME_ACK carrying the status and
+   the allocated transaction ID. */
+void push3_if_init(void);
+
+/* Forward a meter reply (with the NR's registry index, the transaction it
+   answers and the flags from its header, see METER_F_EXTRACTED) to Push3
+   host. Replies are packed into a batch of records:
+     reply: [0x01][txn_id LE16][node LE16][flags][len LE16][payload]
+     node:  [0x02][node LE16][IPv6 16]   (sent once per node, before first use)
+   and sent as one PUSH3_FRAME_REPLY_BATCH host-link frame (see push3_link.h)
+   when the batch is full, when the latency budget expires (see
+   push3_if_process) or on push3_flush(). A batch the UART can't take yet
+   is kept and retried; records that no longer fit are dropped and logged.
 */
-void push3_forward_meter_reply(const uint8_t *node_ipv6, const uint8_t *payload, uint16_t len);
+void push3_forward_meter_reply(uint16_t txn_id, uint16_t node, uint8_t flags,
+                               const uint8_t *payload, uint16_t len);
+
+/* Forward an NR's scheduled-poll REPORT (flags from its header, see
+   METER_F_HEARTBEAT) as a batch record:
+     report: [0x03][node LE16][flags][len LE16][payload]
+*/
+void push3_forward_report(uint16_t node, uint8_t flags, const uint8_t *payload, uint16_t len);
+
+/* Report the end of a transaction. Flushes pending replies, then sends a
+   PUSH3_FRAME_COMPLETION frame (queued until the UART has room):
+     [txn_id LE16][reason][n_nodes LE16][replied bitmap][missing bitmap]
+   Bitmaps are indexed by node index and n_nodes bits long. */
+void push3_report_completion(uint16_t txn_id, uint8_t reason,
+                             const uint8_t *replied, const uint8_t *missing, uint16_t n_nodes);
+
+/* Node index now names another node: its address record goes out again
+   before the index is next used */
+void push3_forget_node(uint16_t node);
+
+/* Send any pending batched replies now (e.g. when a correlation round completes) */
+void push3_flush(void);
+
+/* Change the latency budget; 0 disables batching (every reply is flushed immediately) */
+void push3_set_latency_budget_ms(uint32_t ms);
+
+/* Main-loop service: polls host commands and flushes the batch once its
+   oldest reply exceeds the budget */
+void push3_if_process(void);
 
 #ifdef __cplusplus
 }
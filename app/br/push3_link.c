@@ -0,0 +1,167 @@
+#include "push3_link.h"
+#include "uart.h"
+#include "log.h"
+#include "../common/crc16.h"
+#include <stdbool.h>
+
+/* Worst-case COBS-encoded frame plus delimiter */
+#define PUSH3_LINK_WIRE_MAX(frame) ((frame) + (frame) / 254 + 2)
+
+#if PUSH3_LINK_WIRE_MAX(PUSH3_LINK_HDR_LEN + PUSH3_LINK_MAX_PAYLOAD + PUSH3_LINK_CRC_LEN) > UART_TX_LOG_RESERVE
+#error "UART_TX_LOG_RESERVE must hold one full Push3 frame"
+#endif
+#if PUSH3_LINK_WIRE_MAX(PUSH3_LINK_HDR_LEN + PUSH3_LINK_MAX_PAYLOAD + PUSH3_LINK_CRC_LEN) > UART_RX_RING_SIZE
+#error "UART_RX_RING_SIZE must hold one full Push3 frame"
+#endif
+
+static uint8_t tx_seq = 0;
+static push3_link_rx_cb_t g_rx_cb = NULL;
+
+/* RX: streaming COBS decoder writing into rx_frame */
+static uint8_t rx_frame[PUSH3_LINK_HDR_LEN + PUSH3_LINK_MAX_PAYLOAD + PUSH3_LINK_CRC_LEN];
+static uint16_t rx_len = 0;
+static uint8_t rx_block_left = 0;   // data bytes left in the current COBS block
+static uint8_t rx_last_code = 0;    // 0 = no block started yet
+static bool rx_overflow = false;
+
+/* Streaming COBS encoder: bytes are collected into the current block until a
+   zero or 254 non-zero bytes, then [code][block] goes out in one write.
+*/
+static uint8_t cobs_block[255];     // [0] = code byte
+static uint8_t cobs_n = 0;          // non-zero bytes in the block
+
+static void cobs_flush_block(void)
+{
+    /* code = distance to the next zero; 0xFF marks a full block without one */
+    cobs_block[0] = (uint8_t)(cobs_n + 1);
+    uart_send_buffer(cobs_block, (uint16_t)(cobs_n + 1));
+    cobs_n = 0;
+}
+
+static void cobs_put(const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        if (data[i] == 0) {
+            cobs_flush_block();
+        } else {
+            cobs_block[1 + cobs_n++] = data[i];
+            if (cobs_n == 254) cobs_flush_block();
+        }
+    }
+}
+
+static void cobs_end(void)
+{
+    static const uint8_t delim = 0x00;
+    cobs_flush_block();
+    uart_send_buffer(&delim, 1);
+}
+
+static void rx_reset(void)
+{
+    rx_len = 0;
+    rx_block_left = 0;
+    rx_last_code = 0;
+    rx_overflow = false;
+}
+
+void push3_link_init(push3_link_rx_cb_t rx_cb)
+{
+    g_rx_cb = rx_cb;
+    tx_seq = 0;
+    cobs_n = 0;
+    rx_reset();
+}
+
+int push3_link_send(uint8_t type, const push3_span_t *spans, uint8_t n_spans)
+{
+    uint32_t len = 0;
+    for (uint8_t i = 0; i < n_spans; i++) len += spans[i].len;
+    if (len > PUSH3_LINK_MAX_PAYLOAD) return -1;
+
+    /* A frame the UART can't take whole is refused rather than cut short;
+       log output never uses the last UART_TX_LOG_RESERVE bytes, so this
+       only waits for earlier frames to drain */
+    uint32_t frame = PUSH3_LINK_HDR_LEN + len + PUSH3_LINK_CRC_LEN;
+    if (PUSH3_LINK_WIRE_MAX(frame) > uart_tx_free()) return -1;
+
+    uint8_t seq = tx_seq++;
+    uint8_t hdr[PUSH3_LINK_HDR_LEN] = { type, seq, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    uint16_t crc = crc16_update(CRC16_INIT, hdr, sizeof(hdr));
+
+    uart_log_hold(true);
+    cobs_n = 0;
+    cobs_put(hdr, sizeof(hdr));
+    for (uint8_t i = 0; i < n_spans; i++) {
+        crc = crc16_update(crc, spans[i].data, spans[i].len);
+        cobs_put(spans[i].data, spans[i].len);
+    }
+    uint8_t trailer[PUSH3_LINK_CRC_LEN] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+    cobs_put(trailer, sizeof(trailer));
+    cobs_end();
+    uart_log_hold(false);
+    return seq;
+}
+
+static void rx_nack(uint8_t seq)
+{
+    uint8_t ack[4] = { seq, PUSH3_STATUS_BAD_FRAME, 0, 0 };
+    push3_span_t span = { ack, sizeof(ack) };
+    push3_link_send(PUSH3_FRAME_ACK, &span, 1);
+}
+
+static void rx_frame_done(void)
+{
+    if (rx_len == 0) return;                     // back-to-back delimiters
+    if (rx_overflow || rx_block_left != 0 || rx_len < PUSH3_LINK_HDR_LEN + PUSH3_LINK_CRC_LEN) {
+        LOG_WARN("[Push3 link] malformed frame len=%u", (unsigned)rx_len);
+        if (rx_len >= PUSH3_LINK_HDR_LEN) rx_nack(rx_frame[1]);
+        return;
+    }
+
+    uint16_t plen = (uint16_t)(rx_frame[2] | (rx_frame[3] << 8));
+    uint16_t body = (uint16_t)(PUSH3_LINK_HDR_LEN + plen);
+    uint16_t crc = (uint16_t)(rx_frame[rx_len - 2] | (rx_frame[rx_len - 1] << 8));
+    if (body + PUSH3_LINK_CRC_LEN != rx_len || crc16_update(CRC16_INIT, rx_frame, body) != crc) {
+        LOG_WARN("[Push3 link] bad length/CRC seq=%u", (unsigned)rx_frame[1]);
+        rx_nack(rx_frame[1]);
+        return;
+    }
+
+    if (g_rx_cb) g_rx_cb(rx_frame[0], rx_frame[1], &rx_frame[PUSH3_LINK_HDR_LEN], plen);
+}
+
+/* Feed one received span through the COBS decoder */
+static void rx_span(const uint8_t *data, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        uint8_t b = data[i];
+
+        if (b == 0) {
+            rx_frame_done();
+            rx_reset();
+            continue;
+        }
+        if (rx_block_left == 0) {
+            /* Code byte: the previous block ended in an (implicit) zero unless it was full */
+            if (rx_last_code != 0 && rx_last_code != 0xFF) {
+                if (rx_len < sizeof(rx_frame)) rx_frame[rx_len++] = 0; else rx_overflow = true;
+            }
+            rx_last_code = b;
+            rx_block_left = (uint8_t)(b - 1);
+            continue;
+        }
+        if (rx_len < sizeof(rx_frame)) rx_frame[rx_len++] = b; else rx_overflow = true;
+        rx_block_left--;
+    }
+}
+
+void push3_link_poll(void)
+{
+    const uint8_t *span;
+    uint16_t n;
+    while ((n = uart_rx_peek(&span)) != 0) {
+        rx_span(span, n);
+        uart_rx_consume(n);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PUSH3_LINK_H
+#define PUSH3_LINK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Binary BR<->Push3 host-link framing.
+
+   Frame (before stuffing):
+     | type | seq | len (LE16) | payload (len bytes) | crc16 (LE16) |
+   The CRC (CRC-16/CCITT-FALSE) covers type..payload. The frame is COBS
+   encoded and terminated by a 0x00 delimiter, so a receiver resyncs on the
+   next 0x00 and stray text on the same UART (debug log) is rejected by the
+   CRC check.
+*/
+#define PUSH3_LINK_HDR_LEN   4
+#define PUSH3_LINK_CRC_LEN   2
+/* Room for one reassembled meter dump (METER_DUMP_MAX) plus record headers */
+#define PUSH3_LINK_MAX_PAYLOAD 2304
+
+typedef enum {
+    PUSH3_FRAME_REPLY_BATCH = 0x01,   /* BR -> host: batched NR replies */
+    PUSH3_FRAME_ACK         = 0x02,   /* BR -> host: [seq][status][txn_id LE16] */
+    PUSH3_FRAME_COMPLETION  = 0x03,   /* BR -> host: end of a transaction, see push3_if.h */
+
+    PUSH3_CMD_METER_REQUEST  = 0x10,  /* host -> BR: [meter request] to all NRs */
+    PUSH3_CMD_TARGETED_REQUEST = 0x11,/* host -> BR: [n LE16][n x IPv6][meter request] */
+    PUSH3_CMD_SET_MAX_AGE    = 0x12,  /* host -> BR: [max_age_s LE16] for following requests */
+    PUSH3_CMD_SCHEDULE_REQUEST = 0x13,/* host -> BR: [schedule 12][n LE16][n x IPv6][meter request] */
+    PUSH3_CMD_SET_EXTRACT    = 0x14,  /* host -> BR: [n x extract selector] for following requests */
+    PUSH3_CMD_RESYNC         = 0x15,  /* host -> BR: empty; host (re)connected, resend node records */
+} push3_frame_type_t;
+
+/* Status codes carried in PUSH3_FRAME_ACK */
+typedef enum {
+    PUSH3_STATUS_OK          = 0,
+    PUSH3_STATUS_BAD_FRAME   = 1,     /* length or CRC mismatch */
+    PUSH3_STATUS_UNKNOWN_CMD = 2,
+    PUSH3_STATUS_BAD_ARGS    = 3,
+    PUSH3_STATUS_SEND_FAILED = 4,
+    PUSH3_STATUS_NO_NODE_SLOT = 5,    /* a target could not be given a node index */
+} push3_status_t;
+
+/* Called for every received frame that passed the CRC check.
+   payload points into the link's RX buffer and is valid only during the call. */
+typedef void (*push3_link_rx_cb_t)(uint8_t type, uint8_t seq, const uint8_t *payload, uint16_t len);
+
+/* A payload fragment; frames are written directly from a list of these */
+typedef struct {
+    const uint8_t *data;
+    uint16_t len;
+} push3_span_t;
+
+void push3_link_init(push3_link_rx_cb_t rx_cb);
+
+/**
+ * Frame, stuff and transmit spans[0..n_spans) as one frame of the given type.
+ * Returns the sequence number used, or -1 if the payload is too large.
+ */
+int push3_link_send(uint8_t type, const push3_span_t *spans, uint8_t n_spans);
+
+/**
+ * Drain the host UART RX ring, unstuffing bytes straight into the frame
+ * buffer. Complete frames are CRC-checked and handed to the RX callback;
+ * corrupt frames are reported with PUSH3_STATUS_BAD_FRAME when their header
+ * is readable. Call from the main loop.
+ */
+void push3_link_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUSH3_LINK_H
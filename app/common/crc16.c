@@ -0,0 +1,12 @@
+#include "crc16.h"
+
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        /* Byte-wise shift/xor formulation, no lookup table */
+        uint8_t x = (uint8_t)((crc >> 8) ^ data[i]);
+        x ^= x >> 4;
+        crc = (uint16_t)((crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x);
+    }
+    return crc;
+}
@@ -0,0 +1,19 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRC16_INIT 0xFFFF
+
+/* CRC-16/CCITT-FALSE (poly 0x1021). Chain calls by passing the previous result. */
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRC16_H
@@ -0,0 +1,111 @@
+#include "meter_delta.h"
+#include <string.h>
+
+/* Modbus RTU reply: [addr][fc][byte count][registers][crc LE16] */
+#define MB_HDR_LEN 3
+#define MB_CRC_LEN 2
+
+static uint16_t modbus_crc(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0xA001) : (uint16_t)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static bool modbus_frame_ok(const uint8_t *f, uint16_t len)
+{
+    if (len < MB_HDR_LEN + MB_CRC_LEN || f[2] != len - MB_HDR_LEN - MB_CRC_LEN) return false;
+    uint16_t crc = modbus_crc(f, (uint16_t)(len - MB_CRC_LEN));
+    return f[len - 2] == (uint8_t)(crc & 0xFF) && f[len - 1] == (uint8_t)(crc >> 8);
+}
+
+/* Column width in bytes, 0 for unknown layouts */
+static uint8_t col_width(uint8_t layout)
+{
+    switch (layout) {
+    case METER_LAYOUT_MODBUS_U16: return 2;
+    case METER_LAYOUT_MODBUS_U32: return 4;
+    default: return 0;
+    }
+}
+
+static uint32_t get_be(const uint8_t *p, uint8_t w)
+{
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < w; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_be(uint8_t *p, uint8_t w, uint32_t v)
+{
+    for (int i = w - 1; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+/* Difference wrapped to the column width, as the smallest signed value */
+static int32_t col_diff(uint32_t a, uint32_t b, uint8_t w)
+{
+    return (w == 2) ? (int16_t)(uint16_t)(a - b) : (int32_t)(a - b);
+}
+
+int meter_delta_encode(uint8_t layout, const uint8_t *key, uint16_t key_len,
+                       const uint8_t *frame, uint16_t len, uint8_t *out, uint16_t cap)
+{
+    uint8_t w = col_width(layout);
+    if (!w || len != key_len || len > METER_DELTA_FRAME_MAX) return -1;
+    if (memcmp(key, frame, MB_HDR_LEN) != 0 || !modbus_frame_ok(frame, len)) return -1;
+
+    uint16_t data_len = (uint16_t)(len - MB_HDR_LEN - MB_CRC_LEN);
+    if (data_len % w) return -1;
+
+    uint16_t n = 0;
+    for (uint16_t off = MB_HDR_LEN; off < MB_HDR_LEN + data_len; off += w) {
+        int32_t d = col_diff(get_be(&frame[off], w), get_be(&key[off], w), w);
+        uint32_t z = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+        do {
+            if (n >= cap || n >= len - 1) return -1;    // no gain over the raw frame
+            out[n++] = (uint8_t)((z & 0x7F) | (z > 0x7F ? 0x80 : 0));
+            z >>= 7;
+        } while (z);
+    }
+    return n;
+}
+
+int meter_delta_decode(uint8_t layout, const uint8_t *key, uint16_t key_len,
+                       const uint8_t *in, uint16_t in_len, uint8_t *frame, uint16_t cap)
+{
+    uint8_t w = col_width(layout);
+    if (!w || key_len > cap || key_len < MB_HDR_LEN + MB_CRC_LEN) return -1;
+
+    uint16_t data_len = (uint16_t)(key_len - MB_HDR_LEN - MB_CRC_LEN);
+    if (data_len % w) return -1;
+
+    memcpy(frame, key, key_len);
+    uint16_t pos = 0;
+    for (uint16_t off = MB_HDR_LEN; off < MB_HDR_LEN + data_len; off += w) {
+        uint32_t z = 0;
+        uint8_t shift = 0;
+        uint8_t b;
+        do {
+            if (pos >= in_len || shift > 28) return -1;
+            b = in[pos++];
+            z |= (uint32_t)(b & 0x7F) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        int32_t d = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+        put_be(&frame[off], w, get_be(&key[off], w) + (uint32_t)d);
+    }
+    if (pos != in_len) return -1;
+
+    uint16_t crc = modbus_crc(frame, (uint16_t)(key_len - MB_CRC_LEN));
+    frame[key_len - 2] = (uint8_t)(crc & 0xFF);
+    frame[key_len - 1] = (uint8_t)(crc >> 8);
+    return key_len;
+}
@@ -0,0 +1,41 @@
+#ifndef METER_DELTA_H
+#define METER_DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Column-wise delta coding of meter reply frames against a keyframe.
+   A delta carries, per column, the zig-zag varint of (frame - keyframe);
+   all other bytes of the frame must equal the keyframe's. */
+
+/* Largest frame that can be delta coded (and kept as a keyframe) */
+#define METER_DELTA_FRAME_MAX 128
+
+/* Known register layouts */
+typedef enum {
+    METER_LAYOUT_RAW        = 0,  /* not delta coded */
+    METER_LAYOUT_MODBUS_U16 = 1,  /* Modbus RTU FC 03/04 reply, one column per register */
+    METER_LAYOUT_MODBUS_U32 = 2,  /* same, one column per register pair (big-endian u32) */
+} meter_layout_t;
+
+/**
+ * Delta code frame against key. Returns the encoded length, or -1 if the
+ * layout doesn't apply (frame shape differs from the key, bad Modbus CRC) or
+ * the result would not be shorter than the frame; send a keyframe then.
+ */
+int meter_delta_encode(uint8_t layout, const uint8_t *key, uint16_t key_len,
+                       const uint8_t *frame, uint16_t len, uint8_t *out, uint16_t cap);
+
+/** Rebuild a frame from key and a delta. Returns the frame length, or -1. */
+int meter_delta_decode(uint8_t layout, const uint8_t *key, uint16_t key_len,
+                       const uint8_t *in, uint16_t in_len, uint8_t *frame, uint16_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METER_DELTA_H
@@ -0,0 +1,105 @@
+#include "meter_proto.h"
+#include <string.h>
+
+int meter_hdr_encode(uint8_t *buf, uint16_t cap, const meter_hdr_t *hdr)
+{
+    if (!buf || !hdr) return -1;
+    uint16_t total = (uint16_t)(METER_HDR_BASE_LEN + hdr->opts_len);
+    if (hdr->opts_len > METER_HDR_MAX_OPTS || total > cap) return -1;
+
+    buf[0] = METER_PROTO_VERSION;
+    buf[1] = hdr->type;
+    buf[2] = (uint8_t)(hdr->txn_id & 0xFF);
+    buf[3] = (uint8_t)(hdr->txn_id >> 8);
+    buf[4] = hdr->flags;
+    buf[5] = hdr->opts_len;
+    if (hdr->opts_len) memcpy(&buf[METER_HDR_BASE_LEN], hdr->opts, hdr->opts_len);
+    return total;
+}
+
+int meter_hdr_decode(const uint8_t *buf, uint16_t len, meter_hdr_t *hdr)
+{
+    if (!buf || !hdr || len < METER_HDR_BASE_LEN) return -1;
+    if (buf[0] != METER_PROTO_VERSION) return -1;
+
+    uint8_t opts_len = buf[5];
+    if (opts_len > METER_HDR_MAX_OPTS || METER_HDR_BASE_LEN + opts_len > len) return -1;
+
+    hdr->type = buf[1];
+    hdr->txn_id = (uint16_t)(buf[2] | (buf[3] << 8));
+    hdr->flags = buf[4];
+    hdr->opts_len = opts_len;
+    hdr->opts = opts_len ? &buf[METER_HDR_BASE_LEN] : NULL;
+    hdr->payload = &buf[METER_HDR_BASE_LEN + opts_len];
+    hdr->payload_len = (uint16_t)(len - METER_HDR_BASE_LEN - opts_len);
+    return 0;
+}
+
+int meter_opt_put(uint8_t *opts, uint16_t used, uint16_t cap,
+                  uint8_t type, const uint8_t *val, uint8_t len)
+{
+    if (!opts || (uint32_t)used + 2 + len > cap) return -1;
+    opts[used] = type;
+    opts[used + 1] = len;
+    if (len) memcpy(&opts[used + 2], val, len);
+    return used + 2 + len;
+}
+
+int meter_opt_find(const meter_hdr_t *hdr, uint8_t type, const uint8_t **val, uint8_t *len)
+{
+    uint16_t i = 0;
+    while (hdr->opts && i + 2 <= hdr->opts_len) {
+        uint8_t olen = hdr->opts[i + 1];
+        if (i + 2 + olen > hdr->opts_len) return -1;    // truncated option
+        if (hdr->opts[i] == type) {
+            if (val) *val = &hdr->opts[i + 2];
+            if (len) *len = olen;
+            return 0;
+        }
+        i = (uint16_t)(i + 2 + olen);
+    }
+    return -1;
+}
+
+uint8_t meter_bloom_size_for(uint16_t n_targets)
+{
+    /* >= 10 bits per target, rounded up to a power of two */
+    uint32_t bytes = ((uint32_t)n_targets * 10 + 7) / 8;
+    uint8_t size = 1;
+    while (size < bytes && size < METER_BLOOM_MAX_BYTES) size <<= 1;
+    return size;
+}
+
+/* Kirsch-Mitzenmacher double hashing: bit_i = h1 + i*h2 (mod m) */
+static void meter_bloom_hash(const uint8_t iid[8], uint32_t *h1, uint32_t *h2)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 8; i++) {
+        h = (h ^ iid[i]) * 16777619u;
+    }
+    *h1 = h;
+    *h2 = ((h >> 17) | (h << 15)) | 1u;
+}
+
+void meter_bloom_add(uint8_t *bits, uint8_t nbytes, const uint8_t iid[8])
+{
+    uint32_t h1, h2, m = (uint32_t)nbytes * 8;
+    if (m == 0) return;
+    meter_bloom_hash(iid, &h1, &h2);
+    for (uint32_t i = 0; i < METER_BLOOM_K; i++) {
+        uint32_t bit = (h1 + i * h2) & (m - 1);
+        bits[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+    }
+}
+
+bool meter_bloom_test(const uint8_t *bits, uint8_t nbytes, const uint8_t iid[8])
+{
+    uint32_t h1, h2, m = (uint32_t)nbytes * 8;
+    if (m == 0 || (nbytes & (nbytes - 1)) != 0) return true;   // malformed filter: fail open
+    meter_bloom_hash(iid, &h1, &h2);
+    for (uint32_t i = 0; i < METER_BLOOM_K; i++) {
+        uint32_t bit = (h1 + i * h2) & (m - 1);
+        if (!(bits[bit >> 3] & (1u << (bit & 7)))) return false;
+    }
+    return true;
+}
@@ -0,0 +1,146 @@
+#ifndef METER_PROTO_H
+#define METER_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Application header carried in front of every BR<->NR meter message.
+
+   | ver | type | txn_id (LE16) | flags | opt_len | options (TLV) | payload ... |
+
+   Options are encoded as [type][len][value...] and are skipped by receivers
+   that do not understand them.
+*/
+#define METER_PROTO_VERSION   1
+#define METER_HDR_BASE_LEN    6
+#define METER_HDR_MAX_OPTS    160
+
+/* UDP port used for BR<->NR meter traffic */
+#define METER_UDP_PORT        4000
+
+/* Multicast group the BR sends requests to; every NR joins it */
+#define METER_NRS_MULTICAST_ADDR { \
+    0xff, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, \
+    0x00, 0x00, 0x00, 0x00, 0x12, 0x34, 0x56, 0x78 }
+
+/* Transaction ID 0 is never allocated; it marks an untracked message */
+#define METER_TXN_NONE        0
+
+typedef enum {
+    METER_MSG_REQUEST = 1,
+    METER_MSG_REPLY   = 2,
+    METER_MSG_REPORT  = 3,      /* NR -> BR, unsolicited result of a scheduled poll */
+    METER_MSG_SEGMENT = 4,      /* NR -> BR, one piece of a large REPLY */
+    METER_MSG_SEG_NACK = 5,     /* BR -> NR, segments still missing */
+    METER_MSG_KEY_NACK = 6,     /* BR -> NR, payload [key_id]: keyframe unknown, send a new one */
+} meter_msg_type_t;
+
+/* Header flags */
+#define METER_F_HEARTBEAT     0x01  /* REPORT carries a heartbeat digest, not meter data */
+#define METER_F_KEYFRAME      0x02  /* payload is [layout][key_id][meter frame] */
+#define METER_F_DELTA         0x04  /* payload is [layout][key_id][deltas], see meter_delta.h */
+#define METER_F_EXTRACTED     0x08  /* payload holds only the fields of METER_OPT_EXTRACT */
+
+/* Option types */
+typedef enum {
+    METER_OPT_TARGET_BLOOM = 1,   /* Bloom filter over the IIDs of addressed NRs */
+    METER_OPT_REPLY_WINDOW = 2,   /* [window_ms LE16][slots LE16] reply spreading */
+    METER_OPT_MAX_AGE      = 3,   /* [max_age_s LE16] NR may answer from a reply this old */
+    METER_OPT_SCHEDULE     = 4,   /* poll the request locally, see METER_SCHEDULE_LEN */
+    METER_OPT_EXTRACT      = 5,   /* reply with selected fields only, see METER_EXTRACT_* */
+} meter_opt_type_t;
+
+/* METER_OPT_SCHEDULE value:
+     [interval_s LE16][heartbeat_s LE16][val_off LE16][val_len][threshold LE32][layout]
+   The NR reads its meter with the request payload every interval_s (0 cancels)
+   and sends a REPORT when the big-endian value of val_len (1..4) bytes at
+   val_off of the meter reply moved by threshold or more since the last report
+   (val_len 0: when the reply changed at all). Every heartbeat_s (0 = never) it
+   sends a REPORT with METER_F_HEARTBEAT and payload
+     [polls LE16][answered LE16][reports LE16][crc16 of last reply LE16]
+   With a layout other than METER_LAYOUT_RAW (meter_delta.h) reports are sent
+   as a keyframe followed by deltas against it (METER_F_KEYFRAME/DELTA).
+   A BR that gets a delta against a keyframe it doesn't hold (lost, or
+   evicted) answers with KEY_NACK; the NR then polls at once and reports a
+   fresh keyframe. */
+#define METER_SCHEDULE_LEN     12
+
+/* METER_OPT_EXTRACT value: up to METER_EXTRACT_MAX_SEL selectors
+     [kind][a LE16][b]
+   whose fields are concatenated, in order, as the reply payload. */
+#define METER_EXTRACT_BYTES       1   /* a = byte offset, b = byte count */
+#define METER_EXTRACT_MODBUS_REGS 2   /* a = first register, b = register count (FC 03/04 reply) */
+#define METER_EXTRACT_SEL_LEN     4
+#define METER_EXTRACT_MAX_SEL     16
+
+/* Large replies: a REPLY (or REPORT) whose payload exceeds METER_SEG_DATA_MAX
+   is sent as SEGMENTs carrying its txn_id and flags, each with payload
+     [orig type][seg idx][seg count][total len LE16][data]
+   where every segment but the last holds exactly METER_SEG_DATA_MAX bytes.
+   The BR answers a gap with SEG_NACK, same txn_id, payload
+     [seg count][bitmap of missing segments]
+   and with an all-zero bitmap once the reply is complete. */
+#define METER_DUMP_MAX         2048
+#define METER_SEG_DATA_MAX     256
+#define METER_SEG_HDR_LEN      5
+#define METER_SEG_MAX          ((METER_DUMP_MAX + METER_SEG_DATA_MAX - 1) / METER_SEG_DATA_MAX)
+
+/* Target filter: k bit positions per node, filter size a power of two in bytes.
+   A filter holds at most METER_BLOOM_MAX_TARGETS nodes at >= 10 bits each;
+   past that its false-positive rate climbs fast (~33% for 200 nodes in 64
+   bytes), so larger target sets are split over several filters. */
+#define METER_BLOOM_K          3
+#define METER_BLOOM_MAX_BYTES  64
+#define METER_BLOOM_MAX_TARGETS ((METER_BLOOM_MAX_BYTES * 8) / 10)
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  flags;
+    uint16_t txn_id;
+    const uint8_t *opts;        /* points into the buffer passed to decode */
+    uint8_t  opts_len;
+    const uint8_t *payload;     /* points into the buffer passed to decode */
+    uint16_t payload_len;
+} meter_hdr_t;
+
+/**
+ * Write the header (and hdr->opts, if any) to buf.
+ * The payload is not copied; the caller appends it after the returned length.
+ * Returns the header length, or -1 if it does not fit in cap.
+ */
+int meter_hdr_encode(uint8_t *buf, uint16_t cap, const meter_hdr_t *hdr);
+
+/**
+ * Parse a received message in place. opts/payload point into buf.
+ * Returns 0 on success, -1 if the message is malformed or of another version.
+ */
+int meter_hdr_decode(const uint8_t *buf, uint16_t len, meter_hdr_t *hdr);
+
+/**
+ * Append a [type][len][value] option to an option area of capacity cap.
+ * Returns the new option area length, or -1 if it does not fit.
+ */
+int meter_opt_put(uint8_t *opts, uint16_t used, uint16_t cap,
+                  uint8_t type, const uint8_t *val, uint8_t len);
+
+/** Find option type in a decoded header. Returns 0 and sets val/len if present. */
+int meter_opt_find(const meter_hdr_t *hdr, uint8_t type, const uint8_t **val, uint8_t *len);
+
+/** Smallest power-of-two filter size (bytes) giving 10-20 bits per target,
+    about 0.3-1.7% false positives with METER_BLOOM_K = 3. Capped at
+    METER_BLOOM_MAX_BYTES: only accurate up to METER_BLOOM_MAX_TARGETS. */
+uint8_t meter_bloom_size_for(uint16_t n_targets);
+
+/** Add / test a node, identified by the interface ID (low 8 bytes) of its IPv6 address */
+void meter_bloom_add(uint8_t *bits, uint8_t nbytes, const uint8_t iid[8]);
+bool meter_bloom_test(const uint8_t *bits, uint8_t nbytes, const uint8_t iid[8]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // METER_PROTO_H
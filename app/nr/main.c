@@ -3,12 +3,22 @@
 #include "stack_if.h"
 #include "nr_handler.h"
 #include "uart_485.h"
+#include "pins.h"
+
+/* Bus starts at 9600; the NR may raise it once the meter is probed (nr_baud) */
+static const uart485_config_t rs485_cfg = {
+    .eusart   = RS485_EUSART,
+    .tx_port  = RS485_TX_PORT,  .tx_pin  = RS485_TX_PIN,
+    .rx_port  = RS485_RX_PORT,  .rx_pin  = RS485_RX_PIN,
+    .rts_port = RS485_RTS_PORT, .rts_pin = RS485_RTS_PIN,
+    .baudrate = 9600,
+};
 
 int main(void)
 {
     board_init();
     log_init();
-    uart485_init(9600);
+    uart485_init(&rs485_cfg);
 
     LOG_INFO("[NR] boot");
 
@@ -24,6 +34,7 @@ int main(void)
     while (1) {
         wsun_process();
         uart485_poll();
+        nr_handler_process();
     }
     return 0;
 }
@@ -0,0 +1,176 @@
+#include "nr_baud.h"
+#include "nr_meter_q.h"
+#include "uart_485.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include "nvm3_default.h"
+#include <string.h>
+
+static const uint32_t rates[] = NR_BAUD_RATES;
+#define N_RATES ((uint8_t)(sizeof(rates) / sizeof(rates[0])))
+
+static const uint8_t probe_req[] = NR_BAUD_PROBE_REQ;
+static const uint8_t probe_prefix[] = NR_BAUD_PROBE_REPLY_PREFIX;
+
+typedef enum {
+    BAUD_DONE = 0,
+    BAUD_PROBE_IDLE,    /* next probe goes out when the bus is free */
+    BAUD_PROBE_SENT,
+} baud_state_t;
+
+#define NO_RATE 0xFF
+
+static baud_state_t state = BAUD_DONE;
+static uint8_t rate_idx = 0;
+static uint8_t stored_idx = NO_RATE;    /* rate in NVM3 */
+static uint8_t probe_idx = 0;           /* rate being probed */
+static uint8_t probe_last = 0;          /* slowest rate this probe tries */
+static uint8_t probe_fallback = 0;      /* rate kept when none answers */
+static uint8_t tries = 0;
+static uint32_t probe_deadline = 0;
+static uint32_t probe_tick = 0;         /* end of the last probe, for the upward re-probe */
+static uint16_t streak_mark = 0;
+
+/* Only called with the meter queue held and the bus idle */
+static void set_rate(uint8_t idx)
+{
+    if (idx == rate_idx) return;
+    rate_idx = idx;
+    uart485_set_baudrate(rates[idx]);
+}
+
+static void persist_rate(void)
+{
+    if (stored_idx == rate_idx) return;
+    uint32_t baud = rates[rate_idx];
+    sl_status_t st = nvm3_writeData(nvm3_defaultHandle, NR_BAUD_NVM3_KEY, &baud, sizeof(baud));
+    if (st != SL_STATUS_OK) {
+        LOG_WARN("[NR] could not persist RS-485 rate, status=0x%lx", (unsigned long)st);
+        return;
+    }
+    stored_idx = rate_idx;
+}
+
+/* Probe rates first..last (fastest first) and keep fallback if none answers.
+   The meter queue is held until the probe is over; the first rate switch
+   waits for the request on the bus to finish. */
+static void probe_start(uint8_t first, uint8_t last, uint8_t fallback)
+{
+    nr_meter_q_hold(true);
+    probe_idx = first;
+    probe_last = last;
+    probe_fallback = fallback;
+    tries = 0;
+    state = BAUD_PROBE_IDLE;
+}
+
+static void probe_done(bool found)
+{
+    state = BAUD_DONE;
+    probe_tick = sl_sleeptimer_get_tick_count();
+    if (found) {
+        LOG_INFO("[NR] meter answers at %lu baud", (unsigned long)rates[rate_idx]);
+        persist_rate();
+    } else {
+        set_rate(probe_fallback);
+        LOG_WARN("[NR] meter probe failed, staying at %lu baud", (unsigned long)rates[rate_idx]);
+    }
+    streak_mark = nr_meter_q_timeout_streak();
+    nr_meter_q_hold(false);
+}
+
+void nr_baud_init(void)
+{
+    uint32_t baud = 0;
+    rate_idx = NO_RATE;
+    stored_idx = NO_RATE;
+    if (nvm3_initDefault() == SL_STATUS_OK &&
+        nvm3_readData(nvm3_defaultHandle, NR_BAUD_NVM3_KEY, &baud, sizeof(baud)) == SL_STATUS_OK) {
+        for (uint8_t i = 0; i < N_RATES; i++) {
+            if (rates[i] == baud) stored_idx = i;
+        }
+    }
+
+    if (stored_idx == NO_RATE) {
+        LOG_INFO("[NR] probing meter rate");
+        set_rate(N_RATES - 1);
+        probe_start(0, N_RATES - 1, N_RATES - 1);
+        return;
+    }
+
+    set_rate(stored_idx);
+    LOG_INFO("[NR] RS-485 at stored %lu baud", (unsigned long)baud);
+    /* The stored rate is a floor, not a ceiling: the meter may have been
+       replaced or reconfigured since. Try the faster rates once. */
+    if (stored_idx > 0) {
+        probe_start(0, (uint8_t)(stored_idx - 1), stored_idx);
+    } else {
+        state = BAUD_DONE;
+        probe_tick = sl_sleeptimer_get_tick_count();
+    }
+}
+
+bool nr_baud_on_frame(const uint8_t *data, uint16_t len)
+{
+    /* Only the answer window is ours; until the probe goes out the bus
+       may still be finishing a queued request */
+    if (state != BAUD_PROBE_SENT) return false;
+
+    /* Noise at the wrong rate is dropped */
+    if (len >= sizeof(probe_prefix) && memcmp(data, probe_prefix, sizeof(probe_prefix)) == 0) {
+        probe_done(true);
+    }
+    return true;
+}
+
+void nr_baud_process(void)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+
+    switch (state) {
+    case BAUD_PROBE_IDLE:
+        if (!nr_meter_q_bus_idle() || uart485_tx_busy()) return;
+        set_rate(probe_idx);
+        probe_deadline = now + sl_sleeptimer_ms_to_tick(NR_BAUD_PROBE_TIMEOUT_MS);
+        state = BAUD_PROBE_SENT;
+        uart485_send(probe_req, sizeof(probe_req), NULL);
+        break;
+
+    case BAUD_PROBE_SENT:
+        if (uart485_tx_busy() || (int32_t)(now - probe_deadline) < 0) return;
+        if (++tries < NR_BAUD_PROBE_TRIES) {
+            state = BAUD_PROBE_IDLE;
+        } else if (probe_idx < probe_last) {
+            tries = 0;
+            probe_idx++;
+            state = BAUD_PROBE_IDLE;
+        } else {
+            probe_done(false);
+        }
+        break;
+
+    case BAUD_DONE: {
+        /* Meters that used to answer stopped: confirm the current rate
+           before giving it up, then work down from it */
+        uint16_t streak = nr_meter_q_timeout_streak();
+        if (streak < streak_mark) streak_mark = 0;
+        if (streak - streak_mark >= NR_BAUD_MAX_ERRORS) {
+            LOG_WARN("[NR] %u meter timeouts at %lu baud, re-probing",
+                     (unsigned)NR_BAUD_MAX_ERRORS, (unsigned long)rates[rate_idx]);
+            probe_start(rate_idx, N_RATES - 1, rate_idx);
+            break;
+        }
+        /* Below the fastest rate: look for a faster one now and then */
+        if (rate_idx > 0 &&
+            (uint32_t)(now - probe_tick) >= (uint32_t)NR_BAUD_REPROBE_S * sl_sleeptimer_get_timer_frequency()) {
+            probe_start(0, (uint8_t)(rate_idx - 1), rate_idx);
+        }
+        break;
+    }
+    }
+}
+
+uint32_t nr_baud_rate(void)
+{
+    return rates[rate_idx];
+}
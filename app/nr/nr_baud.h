@@ -0,0 +1,73 @@
+#ifndef NR_BAUD_H
+#define NR_BAUD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Candidate bus rates, fastest first; the last one is the fallback floor */
+#ifndef NR_BAUD_RATES
+#define NR_BAUD_RATES { 115200, 38400, 19200, 9600 }
+#endif
+
+/* Handshake: a request every meter on the segment answers, and the reply
+   prefix that proves it understood us (default: Modbus read of holding
+   register 0 on meter 1) */
+#ifndef NR_BAUD_PROBE_REQ
+#define NR_BAUD_PROBE_REQ { 0x01, 0x03, 0x00, 0x00, 0x00, 0x01, 0x84, 0x0A }
+#endif
+#ifndef NR_BAUD_PROBE_REPLY_PREFIX
+#define NR_BAUD_PROBE_REPLY_PREFIX { 0x01, 0x03 }
+#endif
+
+#ifndef NR_BAUD_PROBE_TIMEOUT_MS
+#define NR_BAUD_PROBE_TIMEOUT_MS 250
+#endif
+
+/* Probes per rate before trying the next slower one */
+#ifndef NR_BAUD_PROBE_TRIES
+#define NR_BAUD_PROBE_TRIES 2
+#endif
+
+/* Timeouts in a row from meters that answered before, after which the
+   current rate is re-probed and, failing that, the slower ones */
+#ifndef NR_BAUD_MAX_ERRORS
+#define NR_BAUD_MAX_ERRORS 3
+#endif
+
+/* Interval at which a bus below the fastest rate probes the faster ones */
+#ifndef NR_BAUD_REPROBE_S
+#define NR_BAUD_REPROBE_S 3600
+#endif
+
+/* NVM3 object holding the negotiated rate */
+#ifndef NR_BAUD_NVM3_KEY
+#define NR_BAUD_NVM3_KEY 0x0F100
+#endif
+
+/**
+ * Restore the rate persisted by an earlier run and probe the faster ones,
+ * or probe the meter from the fastest candidate down. The meter queue is
+ * held while probing and the rate only changes with the bus idle.
+ * Call after uart485_init() and nr_meter_q_init().
+ */
+void nr_baud_init(void);
+
+/** RS-485 frame hook: returns true if the frame was a probe answer (consumed) */
+bool nr_baud_on_frame(const uint8_t *data, uint16_t len);
+
+/** Main-loop service: drives the probe, re-probes on repeated meter timeouts
+    and periodically tries faster rates */
+void nr_baud_process(void);
+
+/** Current bus rate */
+uint32_t nr_baud_rate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NR_BAUD_H
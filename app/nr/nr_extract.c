@@ -0,0 +1,56 @@
+#include "nr_extract.h"
+#include <string.h>
+
+/* Modbus RTU FC 03/04 reply: registers start after [addr][fc][byte count] */
+#define MB_REG_BASE 3
+
+int nr_extract_compile(const uint8_t *opt, uint8_t opt_len, nr_extract_plan_t *plan)
+{
+    plan->n = 0;
+    if (opt_len == 0 || opt_len % METER_EXTRACT_SEL_LEN ||
+        opt_len / METER_EXTRACT_SEL_LEN > METER_EXTRACT_MAX_SEL) {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < opt_len; i += METER_EXTRACT_SEL_LEN) {
+        uint32_t a = (uint32_t)(opt[i + 1] | (opt[i + 2] << 8));
+        uint32_t b = opt[i + 3];
+        uint32_t off, len;
+
+        switch (opt[i]) {
+        case METER_EXTRACT_BYTES:
+            off = a;
+            len = b;
+            break;
+        case METER_EXTRACT_MODBUS_REGS:
+            off = MB_REG_BASE + 2 * a;
+            len = 2 * b;
+            break;
+        default:
+            plan->n = 0;
+            return -1;
+        }
+        if (len == 0 || off + len > UINT16_MAX) {
+            plan->n = 0;
+            return -1;
+        }
+        plan->sel[plan->n].off = (uint16_t)off;
+        plan->sel[plan->n].len = (uint16_t)len;
+        plan->n++;
+    }
+    return 0;
+}
+
+int nr_extract_run(const nr_extract_plan_t *plan, const uint8_t *frame, uint16_t len,
+                   uint8_t *out, uint16_t cap)
+{
+    uint16_t n = 0;
+    for (uint8_t i = 0; i < plan->n; i++) {
+        uint16_t off = plan->sel[i].off;
+        uint16_t sl = plan->sel[i].len;
+        if ((uint32_t)off + sl > len || (uint32_t)n + sl > cap) return -1;
+        memcpy(&out[n], &frame[off], sl);
+        n = (uint16_t)(n + sl);
+    }
+    return n;
+}
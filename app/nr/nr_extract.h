@@ -0,0 +1,34 @@
+#ifndef NR_EXTRACT_H
+#define NR_EXTRACT_H
+
+#include <stdint.h>
+#include "../common/meter_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Compiled METER_OPT_EXTRACT: protocol-aware selectors resolved to byte ranges */
+typedef struct {
+    uint8_t n;                  /* 0 = forward the whole frame */
+    struct {
+        uint16_t off;
+        uint16_t len;
+    } sel[METER_EXTRACT_MAX_SEL];
+} nr_extract_plan_t;
+
+/** Validate and compile an option value. Returns 0, or -1 if it is malformed. */
+int nr_extract_compile(const uint8_t *opt, uint8_t opt_len, nr_extract_plan_t *plan);
+
+/**
+ * Copy the selected fields of frame to out. Returns the output length, or -1
+ * if the frame is too short for a selector or out too small.
+ */
+int nr_extract_run(const nr_extract_plan_t *plan, const uint8_t *frame, uint16_t len,
+                   uint8_t *out, uint16_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NR_EXTRACT_H
@@ -2,60 +2,162 @@
 #include "stack_if.h"
 #include "log.h"
 #include "uart_485.h"
+#include "nr_meter_q.h"
+#include "nr_meter_cache.h"
+#include "nr_poll.h"
+#include "nr_baud.h"
+#include "nr_extract.h"
+#include "nr_reply_sched.h"
+#include "sl_sleeptimer.h"
+#include "../common/meter_proto.h"
 #include <string.h>
 #include <stdint.h>
-
-#define BR_PORT 4000
-static uint8_t saved_br_ipv6[16];
-static uint8_t meter_req_buf[512];
-static uint16_t meter_req_len = 0;
+#include <stdbool.h>
 
 /* Forward */
 static void wsun_rx_cb(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6);
 static void rs485_rx_cb(const uint8_t *data, uint16_t len);
+static void meter_reply_cb(nr_meter_txn_t *txn, const uint8_t *data, uint16_t len);
 
 void nr_handler_init(void)
 {
     LOG_INFO("[NR] nr_handler_init");
+    nr_meter_q_init(meter_reply_cb);
+    nr_meter_cache_init();
+    nr_poll_init();
+    nr_baud_init();
     wsun_register_rx_cb(wsun_rx_cb);
     uart485_register_rx_cb(rs485_rx_cb);
 }
 
-/* This is called when NR receives a multicast (or unicast request) from BR */
+/* This is called when NR receives a multicast (or unicast request) from BR.
+   Requests are queued and go out on RS-485 one at a time, in arrival order.
+*/
 static void wsun_rx_cb(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6)
 {
     LOG_INFO("[NR] wsun_rx_cb payload len=%u", (unsigned)len);
-    if (src_ipv6) {
-        memcpy(saved_br_ipv6, src_ipv6, 16);
-    } else {
-        memset(saved_br_ipv6, 0, 16);
+
+    meter_hdr_t hdr;
+    if (meter_hdr_decode(payload, len, &hdr) != 0 ||
+        (hdr.type != METER_MSG_REQUEST && hdr.type != METER_MSG_SEG_NACK &&
+         hdr.type != METER_MSG_KEY_NACK)) {
+        LOG_WARN("[NR] Dropping message without request header");
+        return;
+    }
+    if (!src_ipv6) {
+        LOG_WARN("[NR] No BR IPv6; cannot reply");
+        return;
+    }
+    if (hdr.type == METER_MSG_SEG_NACK) {
+        nr_meter_q_on_seg_nack(hdr.txn_id, src_ipv6, hdr.payload, hdr.payload_len);
+        return;
+    }
+    if (hdr.type == METER_MSG_KEY_NACK) {
+        nr_poll_on_key_nack(src_ipv6, hdr.payload, hdr.payload_len);
+        return;
+    }
+
+    /* Targeted poll: drop here if we are not addressed, before touching RS-485 */
+    const uint8_t *bloom;
+    uint8_t bloom_len;
+    if (meter_opt_find(&hdr, METER_OPT_TARGET_BLOOM, &bloom, &bloom_len) == 0) {
+        uint8_t own_ipv6[16];
+        if (wsun_get_global_ipv6(own_ipv6) == 0 &&
+            !meter_bloom_test(bloom, bloom_len, &own_ipv6[8])) {
+            LOG_DEBUG("[NR] txn=%u not addressed to us, ignored", (unsigned)hdr.txn_id);
+            return;
+        }
+    }
+
+    /* Spread our reply over the window the BR advertised */
+    const uint8_t *win;
+    uint8_t win_len;
+    uint32_t delay_ms = 0;
+    if (meter_opt_find(&hdr, METER_OPT_REPLY_WINDOW, &win, &win_len) == 0 && win_len >= 4) {
+        delay_ms = nr_reply_sched_delay_ms((uint16_t)(win[0] | (win[1] << 8)),
+                                           (uint16_t)(win[2] | (win[3] << 8)));
     }
 
-    if (len > sizeof(meter_req_buf)) len = sizeof(meter_req_buf);
-    memcpy(meter_req_buf, payload, len);
-    meter_req_len = (uint16_t)len;
+    /* Schedule attached: keep reading this request locally from now on */
+    const uint8_t *sched;
+    uint8_t sched_len;
+    if (meter_opt_find(&hdr, METER_OPT_SCHEDULE, &sched, &sched_len) == 0) {
+        nr_poll_install(src_ipv6, sched, sched_len, hdr.payload, hdr.payload_len, delay_ms);
+    }
 
-    // Forward to local meter
-    uart485_send(meter_req_buf, meter_req_len);
-    // Wait: reply will come via rs485_rx_cb
+    /* Extraction plan: validated once here, run over the meter reply later */
+    const uint8_t *ext;
+    uint8_t ext_len;
+    nr_extract_plan_t plan = { .n = 0 };
+    if (meter_opt_find(&hdr, METER_OPT_EXTRACT, &ext, &ext_len) == 0 &&
+        nr_extract_compile(ext, ext_len, &plan) != 0) {
+        LOG_WARN("[NR] txn=%u bad extraction plan, sending whole frame", (unsigned)hdr.txn_id);
+    }
+
+    /* Data the BR accepts slightly stale is answered from the cache, keeping the bus free */
+    const uint8_t *age;
+    uint8_t age_len;
+    uint16_t max_age_s = NR_METER_CACHE_DEFAULT_MAX_AGE_S;
+    if (meter_opt_find(&hdr, METER_OPT_MAX_AGE, &age, &age_len) == 0 && age_len >= 2) {
+        max_age_s = (uint16_t)(age[0] | (age[1] << 8));
+    }
+    const uint8_t *cached;
+    uint16_t cached_len;
+    if (nr_meter_cache_get(hdr.payload, hdr.payload_len, max_age_s, &cached, &cached_len)) {
+        LOG_DEBUG("[NR] txn=%u answered from cache", (unsigned)hdr.txn_id);
+        nr_meter_q_push_reply(hdr.txn_id, src_ipv6, hdr.payload, hdr.payload_len,
+                              cached, cached_len, sl_sleeptimer_ms_to_tick(delay_ms), &plan);
+        return;
+    }
+
+    nr_meter_q_push(hdr.txn_id, src_ipv6, hdr.payload, hdr.payload_len,
+                    sl_sleeptimer_ms_to_tick(delay_ms), &plan);
 }
 
-/* Called when RS-485 driver receives the meter reply.
-   This will send a unicast back to the BR (saved_br_ipv6) using wsun_send_multicast()
-   with dest address equal to saved BR IPv6 (treated as unicast).
-*/
+/* Called when RS-485 driver receives the meter reply */
 static void rs485_rx_cb(const uint8_t *data, uint16_t len)
 {
     LOG_INFO("[NR] rs485_rx_cb meter reply len=%u", (unsigned)len);
-    if (saved_br_ipv6[0] == 0) {
-        LOG_WARN("[NR] No BR IPv6 saved; cannot reply");
+    if (nr_baud_on_frame(data, len)) return;
+    nr_meter_q_on_meter_reply(data, len);
+}
+
+/* Meter answered a queued request: build the radio reply for the BR.
+   It carries the transaction ID of the request it answers and is sent as a
+   unicast to the requesting BR once this node's reply slot is reached.
+*/
+static void meter_reply_cb(nr_meter_txn_t *txn, const uint8_t *data, uint16_t len)
+{
+    if (!txn->from_cache) nr_meter_cache_put(txn->req, txn->req_len, data, len);
+    if (txn->txn_id == METER_TXN_NONE) {
+        nr_poll_on_reply(txn, data, len);
         return;
     }
 
-    int rc = wsun_send_multicast(saved_br_ipv6, BR_PORT, data, len);
-    if (rc != 0) {
-        LOG_ERROR("[NR] wsun_send_multicast(unicast) failed rc=%d", rc);
+    meter_hdr_t hdr = {
+        .type = METER_MSG_REPLY,
+        .txn_id = txn->txn_id,
+    };
+    uint8_t *out = &txn->msg[METER_HDR_BASE_LEN];
+    uint16_t cap = (uint16_t)(sizeof(txn->msg) - METER_HDR_BASE_LEN);
+
+    /* Only the requested fields, written straight into the radio message;
+       the whole frame if the reply doesn't fit the plan */
+    int n = txn->plan.n ? nr_extract_run(&txn->plan, data, len, out, cap) : -1;
+    if (n >= 0) {
+        hdr.flags = METER_F_EXTRACTED;
     } else {
-        LOG_INFO("[NR] Sent reply to BR");
+        if (txn->plan.n) LOG_WARN("[NR] txn=%u reply doesn't fit extraction plan", (unsigned)txn->txn_id);
+        n = (len > cap) ? cap : len;
+        memcpy(out, data, (uint16_t)n);
     }
+    if (meter_hdr_encode(txn->msg, METER_HDR_BASE_LEN, &hdr) < 0) return;
+    txn->msg_len = (uint16_t)(METER_HDR_BASE_LEN + n);
+}
+
+void nr_handler_process(void)
+{
+    nr_baud_process();
+    nr_poll_process();
+    nr_meter_q_process();
 }
@@ -9,6 +9,9 @@ extern "C" {
 
 void nr_handler_init(void);
 
+/* Main-loop service: sends replies whose slot has been reached */
+void nr_handler_process(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,90 @@
+#include "nr_meter_cache.h"
+#include "sl_sleeptimer.h"
+#include <string.h>
+
+typedef struct {
+    bool     used;
+    uint32_t hash;
+    uint32_t stored_tick;
+    uint32_t used_tick;     /* last put or hit, for LRU replacement */
+    uint16_t req_len;
+    uint8_t  req[NR_METER_CACHE_REQ_MAX];
+    uint16_t len;
+    uint8_t  data[NR_METER_CACHE_DATA_MAX];
+} nr_cache_entry_t;
+
+static nr_cache_entry_t cache[NR_METER_CACHE_ENTRIES];
+
+/* FNV-1a over the request bytes */
+static uint32_t req_hash(const uint8_t *req, uint16_t len)
+{
+    uint32_t h = 2166136261u;
+    for (uint16_t i = 0; i < len; i++) {
+        h ^= req[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static nr_cache_entry_t *find(const uint8_t *req, uint16_t req_len, uint32_t hash)
+{
+    for (int i = 0; i < NR_METER_CACHE_ENTRIES; i++) {
+        nr_cache_entry_t *e = &cache[i];
+        if (e->used && e->hash == hash && e->req_len == req_len &&
+            memcmp(e->req, req, req_len) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+void nr_meter_cache_init(void)
+{
+    memset(cache, 0, sizeof(cache));
+}
+
+bool nr_meter_cache_get(const uint8_t *req, uint16_t req_len, uint16_t max_age_s,
+                        const uint8_t **data, uint16_t *len)
+{
+    if (max_age_s == 0 || req_len > NR_METER_CACHE_REQ_MAX) return false;
+
+    nr_cache_entry_t *e = find(req, req_len, req_hash(req, req_len));
+    if (!e) return false;
+
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t max_age = (uint32_t)max_age_s * sl_sleeptimer_get_timer_frequency();
+    if ((uint32_t)(now - e->stored_tick) > max_age) {
+        return false;
+    }
+    e->used_tick = now;
+    *data = e->data;
+    *len = e->len;
+    return true;
+}
+
+void nr_meter_cache_put(const uint8_t *req, uint16_t req_len, const uint8_t *data, uint16_t len)
+{
+    if (req_len > NR_METER_CACHE_REQ_MAX || len > NR_METER_CACHE_DATA_MAX) return;
+
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    uint32_t hash = req_hash(req, req_len);
+    nr_cache_entry_t *e = find(req, req_len, hash);
+    if (!e) {
+        e = &cache[0];
+        for (int i = 0; i < NR_METER_CACHE_ENTRIES; i++) {
+            if (!cache[i].used) {
+                e = &cache[i];
+                break;
+            }
+            if ((int32_t)(cache[i].used_tick - e->used_tick) < 0) e = &cache[i];
+        }
+        e->used = true;
+        e->hash = hash;
+        e->req_len = req_len;
+        memcpy(e->req, req, req_len);
+    }
+    e->stored_tick = now;
+    e->used_tick = now;
+    e->len = len;
+    memcpy(e->data, data, len);
+}
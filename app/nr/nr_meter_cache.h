@@ -0,0 +1,48 @@
+#ifndef NR_METER_CACHE_H
+#define NR_METER_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nr_meter_q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Cached meter replies; the least recently used entry is replaced when full */
+#ifndef NR_METER_CACHE_ENTRIES
+#define NR_METER_CACHE_ENTRIES 8
+#endif
+
+/* Requests longer than this are never cached */
+#ifndef NR_METER_CACHE_REQ_MAX
+#define NR_METER_CACHE_REQ_MAX 32
+#endif
+
+/* Replies longer than this are never cached */
+#ifndef NR_METER_CACHE_DATA_MAX
+#define NR_METER_CACHE_DATA_MAX 512
+#endif
+
+/* Max age used when a request carries no METER_OPT_MAX_AGE (0 = always ask the meter) */
+#ifndef NR_METER_CACHE_DEFAULT_MAX_AGE_S
+#define NR_METER_CACHE_DEFAULT_MAX_AGE_S 0
+#endif
+
+void nr_meter_cache_init(void);
+
+/**
+ * Look up the last meter reply to exactly these request bytes.
+ * Returns true and points data/len at it if it is at most max_age_s old.
+ */
+bool nr_meter_cache_get(const uint8_t *req, uint16_t req_len, uint16_t max_age_s,
+                        const uint8_t **data, uint16_t *len);
+
+/** Remember the meter's reply to a request */
+void nr_meter_cache_put(const uint8_t *req, uint16_t req_len, const uint8_t *data, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NR_METER_CACHE_H
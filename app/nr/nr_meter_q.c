@@ -0,0 +1,376 @@
+#include "nr_meter_q.h"
+#include "stack_if.h"
+#include "uart_485.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include <string.h>
+
+typedef struct {
+    bool     used;
+    uint8_t  addr;
+    bool     answered;          /* has answered at least once; only then do its timeouts count */
+    uint32_t last_served;       /* bus grant counter, for round-robin */
+} nr_meter_t;
+
+static nr_meter_txn_t q[NR_METER_Q_DEPTH];
+static nr_meter_t meters[NR_METER_MAX];
+static nr_meter_txn_t *on_bus = NULL;
+static uint32_t bus_timeout_ticks = 0;
+static uint32_t bus_rx_mark = 0;        /* uart485_rx_activity() when the deadline was last set */
+static uint32_t next_seq = 0;
+static uint32_t grants = 0;
+static bool held = false;
+static uint16_t timeout_streak = 0;
+static nr_meter_reply_cb_t g_reply_cb = NULL;
+
+void nr_meter_q_init(nr_meter_reply_cb_t reply_cb)
+{
+    memset(q, 0, sizeof(q));
+    memset(meters, 0, sizeof(meters));
+    on_bus = NULL;
+    next_seq = 0;
+    grants = 0;
+    held = false;
+    timeout_streak = 0;
+    g_reply_cb = reply_cb;
+}
+
+/* No request of the meter is queued or on the bus */
+static bool meter_idle(const nr_meter_t *m)
+{
+    for (int i = 0; i < NR_METER_Q_DEPTH; i++) {
+        if ((q[i].state == NR_METER_QUEUED || q[i].state == NR_METER_ON_BUS) &&
+            q[i].meter == m->addr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Entry for addr. Adding when all entries are taken reuses an idle one,
+   never-answered first (mistyped or absent address), then the one served
+   least recently; NULL if every meter has requests pending. */
+static nr_meter_t *meter_get(uint8_t addr, bool add)
+{
+    nr_meter_t *free_m = NULL;
+    for (int i = 0; i < NR_METER_MAX; i++) {
+        if (meters[i].used && meters[i].addr == addr) return &meters[i];
+        if (!meters[i].used && !free_m) free_m = &meters[i];
+    }
+    if (!add) return NULL;
+
+    if (!free_m) {
+        for (int i = 0; i < NR_METER_MAX; i++) {
+            nr_meter_t *m = &meters[i];
+            if (!meter_idle(m)) continue;
+            if (!free_m || (free_m->answered && !m->answered) ||
+                (free_m->answered == m->answered &&
+                 (int32_t)(m->last_served - free_m->last_served) < 0)) {
+                free_m = m;
+            }
+        }
+        if (!free_m) return NULL;
+        LOG_INFO("[NR] meter %u idle, entry reused for meter %u",
+                 (unsigned)free_m->addr, (unsigned)addr);
+    }
+
+    free_m->used = true;
+    free_m->addr = addr;
+    free_m->answered = false;
+    free_m->last_served = 0;
+    return free_m;
+}
+
+/* Interrupt context: the request has left the wire, the meter's answer
+   time starts now rather than when the transmit was queued */
+static void bus_tx_done(void)
+{
+    nr_meter_txn_t *t = on_bus;
+    if (t) t->deadline_tick = sl_sleeptimer_get_tick_count() + bus_timeout_ticks;
+}
+
+/* Bus idle: grant it to the queued meter served least recently, oldest request first */
+static void bus_kick(void)
+{
+    if (on_bus || held) return;
+
+    nr_meter_txn_t *next = NULL;
+    nr_meter_t *next_m = NULL;
+    for (int i = 0; i < NR_METER_Q_DEPTH; i++) {
+        if (q[i].state != NR_METER_QUEUED) continue;
+        nr_meter_t *m = meter_get(q[i].meter, false);
+        int32_t age = next ? (int32_t)(m->last_served - next_m->last_served) : 0;
+        if (!next || age < 0 || (age == 0 && (int32_t)(q[i].seq - next->seq) < 0)) {
+            next = &q[i];
+            next_m = m;
+        }
+    }
+    if (!next) return;
+
+    next_m->last_served = ++grants;
+    next->state = NR_METER_ON_BUS;
+    bus_timeout_ticks = sl_sleeptimer_ms_to_tick(NR_METER_TIMEOUT_MS);
+    bus_rx_mark = uart485_rx_activity();
+    next->deadline_tick = sl_sleeptimer_get_tick_count() + bus_timeout_ticks;
+    on_bus = next;
+    if (uart485_send(next->req, next->req_len, bus_tx_done) != 0) {
+        LOG_WARN("[NR] RS-485 send failed txn=%u", (unsigned)next->txn_id);
+        next->state = NR_METER_FREE;
+        on_bus = NULL;
+    }
+    // Wait: reply will come via nr_meter_q_on_meter_reply
+}
+
+static uint8_t seg_buf[METER_HDR_BASE_LEN + METER_SEG_HDR_LEN + METER_SEG_DATA_MAX];
+
+/* Send segment idx of t's reply; hdr is the decoded reply in t->msg */
+static int send_segment(const nr_meter_txn_t *t, const meter_hdr_t *hdr, uint8_t idx)
+{
+    uint8_t count = (uint8_t)((hdr->payload_len + METER_SEG_DATA_MAX - 1) / METER_SEG_DATA_MAX);
+    uint16_t off = (uint16_t)(idx * METER_SEG_DATA_MAX);
+    uint16_t len = hdr->payload_len - off;
+    if (len > METER_SEG_DATA_MAX) len = METER_SEG_DATA_MAX;
+
+    meter_hdr_t seg = {
+        .type = METER_MSG_SEGMENT,
+        .flags = hdr->flags,
+        .txn_id = hdr->txn_id,
+    };
+    int hlen = meter_hdr_encode(seg_buf, sizeof(seg_buf), &seg);
+    if (hlen < 0) return -1;
+    uint8_t *p = &seg_buf[hlen];
+    p[0] = hdr->type;
+    p[1] = idx;
+    p[2] = count;
+    p[3] = (uint8_t)(hdr->payload_len & 0xFF);
+    p[4] = (uint8_t)(hdr->payload_len >> 8);
+    memcpy(&p[METER_SEG_HDR_LEN], &hdr->payload[off], len);
+    return wsun_send_unicast(t->reply_ipv6, METER_UDP_PORT, seg_buf,
+                             (uint16_t)(hlen + METER_SEG_HDR_LEN + len));
+}
+
+static void send_reply(nr_meter_txn_t *t)
+{
+    meter_hdr_t hdr;
+    if (meter_hdr_decode(t->msg, t->msg_len, &hdr) == 0 && hdr.payload_len > METER_SEG_DATA_MAX) {
+        /* Too big for one datagram: segments, kept for repair until the BR confirms */
+        uint8_t count = (uint8_t)((hdr.payload_len + METER_SEG_DATA_MAX - 1) / METER_SEG_DATA_MAX);
+        for (uint8_t i = 0; i < count; i++) {
+            if (send_segment(t, &hdr, i) != 0) {
+                LOG_WARN("[NR] segment %u/%u txn=%u not sent", (unsigned)i, (unsigned)count, (unsigned)t->txn_id);
+            }
+        }
+        LOG_INFO("[NR] Sent reply to BR txn=%u in %u segments", (unsigned)t->txn_id, (unsigned)count);
+        t->state = NR_METER_HELD;
+        t->deadline_tick = sl_sleeptimer_get_tick_count() + sl_sleeptimer_ms_to_tick(NR_METER_SEG_HOLD_MS);
+        return;
+    }
+
+    int rc = wsun_send_unicast(t->reply_ipv6, METER_UDP_PORT, t->msg, t->msg_len);
+    if (rc != 0) {
+        LOG_ERROR("[NR] wsun_send_unicast failed rc=%d", rc);
+    } else {
+        LOG_INFO("[NR] Sent reply to BR txn=%u", (unsigned)t->txn_id);
+    }
+    t->state = NR_METER_FREE;
+}
+
+void nr_meter_q_on_seg_nack(uint16_t txn_id, const uint8_t src_ipv6[16],
+                            const uint8_t *payload, uint16_t len)
+{
+    nr_meter_txn_t *t = NULL;
+    for (int i = 0; i < NR_METER_Q_DEPTH && !t; i++) {
+        if (q[i].state == NR_METER_HELD && q[i].txn_id == txn_id &&
+            memcmp(q[i].reply_ipv6, src_ipv6, 16) == 0) {
+            t = &q[i];
+        }
+    }
+    meter_hdr_t hdr;
+    if (!t || len < 1 || meter_hdr_decode(t->msg, t->msg_len, &hdr) != 0) return;
+
+    uint8_t count = (uint8_t)((hdr.payload_len + METER_SEG_DATA_MAX - 1) / METER_SEG_DATA_MAX);
+    if (payload[0] != count || len < 1 + (count + 7) / 8) return;
+
+    const uint8_t *missing = &payload[1];
+    uint8_t resent = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (missing[i >> 3] & (1u << (i & 7))) {
+            send_segment(t, &hdr, i);
+            resent++;
+        }
+    }
+    if (!resent) {
+        t->state = NR_METER_FREE;
+        return;
+    }
+    LOG_INFO("[NR] resent %u segments txn=%u", (unsigned)resent, (unsigned)txn_id);
+    t->deadline_tick = sl_sleeptimer_get_tick_count() + sl_sleeptimer_ms_to_tick(NR_METER_SEG_HOLD_MS);
+}
+
+static bool reply_slot_reached(const nr_meter_txn_t *t, uint32_t now)
+{
+    return (uint32_t)(now - t->rx_tick) >= t->reply_delay;
+}
+
+/* Build the radio reply for t from meter data and send it once its slot is reached */
+static void reply_ready(nr_meter_txn_t *t, const uint8_t *data, uint16_t len)
+{
+    t->msg_len = 0;
+    if (g_reply_cb) g_reply_cb(t, data, len);
+    if (t->msg_len == 0) {
+        t->state = NR_METER_FREE;
+    } else {
+        t->state = NR_METER_REPLY_READY;
+        if (reply_slot_reached(t, sl_sleeptimer_get_tick_count())) send_reply(t);
+    }
+}
+
+static nr_meter_txn_t *alloc_txn(uint16_t txn_id, const uint8_t reply_ipv6[16],
+                                 const uint8_t *req, uint16_t len, uint32_t reply_delay_ticks,
+                                 const nr_extract_plan_t *plan)
+{
+    if (len > NR_METER_REQ_MAX) {
+        LOG_WARN("[NR] meter request len=%u too long, txn=%u dropped", (unsigned)len, (unsigned)txn_id);
+        return NULL;
+    }
+    nr_meter_txn_t *t = NULL;
+    for (int i = 0; i < NR_METER_Q_DEPTH; i++) {
+        if (q[i].state == NR_METER_FREE) {
+            t = &q[i];
+            break;
+        }
+    }
+    if (!t) {
+        LOG_WARN("[NR] meter queue full, txn=%u dropped", (unsigned)txn_id);
+        return NULL;
+    }
+
+    memcpy(t->req, req, len);
+    t->req_len = len;
+    memcpy(t->reply_ipv6, reply_ipv6, 16);
+    t->txn_id = txn_id;
+    t->seq = next_seq++;
+    t->rx_tick = sl_sleeptimer_get_tick_count();
+    t->reply_delay = reply_delay_ticks;
+    t->msg_len = 0;
+    t->from_cache = false;
+    if (plan) {
+        t->plan = *plan;
+    } else {
+        t->plan.n = 0;
+    }
+    return t;
+}
+
+int nr_meter_q_push(uint16_t txn_id, const uint8_t reply_ipv6[16],
+                    const uint8_t *req, uint16_t len, uint32_t reply_delay_ticks,
+                    const nr_extract_plan_t *plan)
+{
+    if (len <= NR_METER_ADDR_OFFSET) {
+        LOG_WARN("[NR] meter request too short, txn=%u dropped", (unsigned)txn_id);
+        return -1;
+    }
+    uint8_t addr = req[NR_METER_ADDR_OFFSET];
+    if (!meter_get(addr, true)) {
+        LOG_WARN("[NR] too many meters, txn=%u for meter %u dropped", (unsigned)txn_id, (unsigned)addr);
+        return -1;
+    }
+    int queued = 0;
+    for (int i = 0; i < NR_METER_Q_DEPTH; i++) {
+        if (q[i].state == NR_METER_QUEUED && q[i].meter == addr) queued++;
+    }
+    if (queued >= NR_METER_Q_PER_METER) {
+        LOG_WARN("[NR] meter %u queue full, txn=%u dropped", (unsigned)addr, (unsigned)txn_id);
+        return -1;
+    }
+
+    nr_meter_txn_t *t = alloc_txn(txn_id, reply_ipv6, req, len, reply_delay_ticks, plan);
+    if (!t) return -1;
+
+    t->meter = addr;
+    t->state = NR_METER_QUEUED;
+    bus_kick();
+    return 0;
+}
+
+int nr_meter_q_push_reply(uint16_t txn_id, const uint8_t reply_ipv6[16],
+                          const uint8_t *req, uint16_t req_len,
+                          const uint8_t *data, uint16_t len, uint32_t reply_delay_ticks,
+                          const nr_extract_plan_t *plan)
+{
+    nr_meter_txn_t *t = alloc_txn(txn_id, reply_ipv6, req, req_len, reply_delay_ticks, plan);
+    if (!t) return -1;
+
+    t->from_cache = true;
+    reply_ready(t, data, len);
+    return 0;
+}
+
+void nr_meter_q_on_meter_reply(const uint8_t *data, uint16_t len)
+{
+    nr_meter_txn_t *t = on_bus;
+    if (!t) {
+        LOG_WARN("[NR] unsolicited meter frame len=%u", (unsigned)len);
+        return;
+    }
+    if (len <= NR_METER_ADDR_OFFSET || data[NR_METER_ADDR_OFFSET] != t->meter) {
+        LOG_WARN("[NR] meter frame not from meter %u, ignored", (unsigned)t->meter);
+        return;
+    }
+    on_bus = NULL;
+    timeout_streak = 0;
+    nr_meter_t *m = meter_get(t->meter, false);
+    if (m) m->answered = true;
+    reply_ready(t, data, len);
+
+    /* Bus is free again: next request goes out right away */
+    bus_kick();
+}
+
+void nr_meter_q_hold(bool hold)
+{
+    held = hold;
+    if (!held) bus_kick();
+}
+
+bool nr_meter_q_bus_idle(void)
+{
+    return on_bus == NULL;
+}
+
+uint16_t nr_meter_q_timeout_streak(void)
+{
+    return timeout_streak;
+}
+
+void nr_meter_q_process(void)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+
+    /* A long reply at a slow rate outlasts any fixed answer time: while
+       bytes keep arriving the meter is still talking */
+    uint32_t rx_mark = uart485_rx_activity();
+    if (on_bus && rx_mark != bus_rx_mark) {
+        bus_rx_mark = rx_mark;
+        on_bus->deadline_tick = now + bus_timeout_ticks;
+    }
+
+    if (on_bus && !uart485_tx_busy() && (int32_t)(now - on_bus->deadline_tick) >= 0) {
+        LOG_WARN("[NR] meter %u timeout txn=%u", (unsigned)on_bus->meter, (unsigned)on_bus->txn_id);
+        /* A meter that never answered says nothing about the bus rate
+           (wrong address, not installed) */
+        nr_meter_t *m = meter_get(on_bus->meter, false);
+        if (m && m->answered && timeout_streak < UINT16_MAX) timeout_streak++;
+        on_bus->state = NR_METER_FREE;
+        on_bus = NULL;
+    }
+    bus_kick();
+
+    for (int i = 0; i < NR_METER_Q_DEPTH; i++) {
+        if (q[i].state == NR_METER_REPLY_READY && reply_slot_reached(&q[i], now)) {
+            send_reply(&q[i]);
+        } else if (q[i].state == NR_METER_HELD && (int32_t)(now - q[i].deadline_tick) >= 0) {
+            q[i].state = NR_METER_FREE;
+        }
+    }
+}
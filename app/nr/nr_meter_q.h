@@ -0,0 +1,135 @@
+#ifndef NR_METER_Q_H
+#define NR_METER_Q_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/meter_proto.h"
+#include "nr_extract.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pending meter transactions the NR accepts before dropping new requests */
+#ifndef NR_METER_Q_DEPTH
+#define NR_METER_Q_DEPTH 8
+#endif
+
+/* Largest meter request */
+#ifndef NR_METER_REQ_MAX
+#define NR_METER_REQ_MAX 256
+#endif
+
+/* Largest meter reply frame; replies over METER_SEG_DATA_MAX go out segmented */
+#ifndef NR_METER_FRAME_MAX
+#define NR_METER_FRAME_MAX METER_DUMP_MAX
+#endif
+
+/* Time a segmented reply is kept for repair (SEG_NACK) after it was sent */
+#ifndef NR_METER_SEG_HOLD_MS
+#define NR_METER_SEG_HOLD_MS 5000
+#endif
+
+/* Silence from the meter, after the request or between parts of its reply,
+   after which the transaction is abandoned */
+#ifndef NR_METER_TIMEOUT_MS
+#define NR_METER_TIMEOUT_MS 1000
+#endif
+
+/* Meters tracked at once; the entry of an idle meter is reused for a new
+   address once all are taken */
+#ifndef NR_METER_MAX
+#define NR_METER_MAX 8
+#endif
+
+/* Queued requests one meter may hold, so a busy meter can't starve the others */
+#ifndef NR_METER_Q_PER_METER
+#define NR_METER_Q_PER_METER 2
+#endif
+
+/* Offset of the meter (slave) address in request and reply frames */
+#ifndef NR_METER_ADDR_OFFSET
+#define NR_METER_ADDR_OFFSET 0
+#endif
+
+typedef enum {
+    NR_METER_FREE = 0,
+    NR_METER_QUEUED,        /* waiting for the bus */
+    NR_METER_ON_BUS,        /* request sent, waiting for the meter */
+    NR_METER_REPLY_READY,   /* radio reply built, waiting for its reply slot */
+    NR_METER_HELD,          /* segmented reply sent, kept until the BR has it all */
+} nr_meter_state_t;
+
+typedef struct {
+    nr_meter_state_t state;
+    uint16_t txn_id;
+    uint32_t seq;               /* arrival order; FIFO per meter */
+    uint8_t  meter;             /* bus address from the request */
+    uint8_t  reply_ipv6[16];
+    uint32_t rx_tick;           /* request arrival */
+    uint32_t reply_delay;       /* reply slot, ticks after rx_tick */
+    uint32_t deadline_tick;     /* meter must answer (HELD: repair ends) before this */
+    bool     from_cache;        /* answered without the bus */
+    nr_extract_plan_t plan;     /* fields to send back (plan.n == 0: whole frame) */
+    uint16_t req_len;
+    uint8_t  req[NR_METER_REQ_MAX];
+    uint16_t msg_len;
+    uint8_t  msg[METER_HDR_BASE_LEN + METER_HDR_MAX_OPTS + NR_METER_FRAME_MAX];
+} nr_meter_txn_t;
+
+/* Meter answered txn: build the radio reply into txn->msg / txn->msg_len.
+   Leave msg_len at 0 to send nothing. */
+typedef void (*nr_meter_reply_cb_t)(nr_meter_txn_t *txn, const uint8_t *data, uint16_t len);
+
+void nr_meter_q_init(nr_meter_reply_cb_t reply_cb);
+
+/**
+ * Queue a meter request. The request goes on the bus as soon as it is free;
+ * the reply is sent to reply_ipv6 no earlier than reply_delay_ticks after now.
+ * plan (may be NULL) is kept with the request for the reply callback.
+ * Requests for different meters are served round-robin, each meter's own
+ * requests in arrival order.
+ * Returns 0, or -1 if the request is too long or the queue (or that meter's
+ * share of it) is full.
+ */
+int nr_meter_q_push(uint16_t txn_id, const uint8_t reply_ipv6[16],
+                    const uint8_t *req, uint16_t len, uint32_t reply_delay_ticks,
+                    const nr_extract_plan_t *plan);
+
+/**
+ * Queue a request that is answered without the bus (e.g. from a cache): data
+ * goes through the reply callback right away and is sent in the reply slot.
+ * Returns 0, or -1 if the queue is full.
+ */
+int nr_meter_q_push_reply(uint16_t txn_id, const uint8_t reply_ipv6[16],
+                          const uint8_t *req, uint16_t req_len,
+                          const uint8_t *data, uint16_t len, uint32_t reply_delay_ticks,
+                          const nr_extract_plan_t *plan);
+
+/** Feed a complete meter reply frame (from the RS-485 driver). Frames whose
+    address doesn't match the meter on the bus (late answers) are ignored. */
+void nr_meter_q_on_meter_reply(const uint8_t *data, uint16_t len);
+
+/** SEG_NACK from src for txn_id: resend the missing segments, or release the
+    reply once nothing is missing */
+void nr_meter_q_on_seg_nack(uint16_t txn_id, const uint8_t src_ipv6[16],
+                            const uint8_t *payload, uint16_t len);
+
+/** Stop issuing queued requests (requests already queued stay queued), or resume */
+void nr_meter_q_hold(bool hold);
+
+/** No request is waiting for a meter answer */
+bool nr_meter_q_bus_idle(void);
+
+/** Meter timeouts in a row since the last answered request, counting only
+    meters that have answered before */
+uint16_t nr_meter_q_timeout_streak(void);
+
+/** Main-loop service: meter timeouts, starting the next request, due replies */
+void nr_meter_q_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NR_METER_Q_H
@@ -0,0 +1,305 @@
+#include "nr_poll.h"
+#include "stack_if.h"
+#include "log.h"
+#include "sl_sleeptimer.h"
+#include "../common/meter_proto.h"
+#include "../common/crc16.h"
+#include "../common/meter_delta.h"
+#include <string.h>
+
+typedef struct {
+    bool     used;
+    uint8_t  br_ipv6[16];
+    uint32_t interval_ticks;
+    uint32_t heartbeat_ticks;   /* 0 = no heartbeat */
+    uint32_t next_poll_tick;
+    uint32_t next_hb_tick;
+    uint16_t val_off;
+    uint8_t  val_len;
+    uint32_t threshold;
+    bool     reported;          /* last_val / last_crc are valid */
+    uint32_t last_val;          /* value in the last report */
+    uint16_t last_crc;          /* crc of the last reply read */
+    uint16_t polls;
+    uint16_t answered;
+    uint16_t reports;
+    uint8_t  layout;            /* meter_layout_t of the reports */
+    uint8_t  key_id;            /* keyframe the BR decodes deltas against */
+    uint8_t  key_uses;          /* deltas sent against it */
+    uint16_t key_len;           /* 0 = no keyframe sent yet */
+    uint8_t  key[METER_DELTA_FRAME_MAX];
+    uint16_t req_len;
+    uint8_t  req[NR_POLL_REQ_MAX];
+} nr_poll_t;
+
+static nr_poll_t polls[NR_POLL_MAX];
+static uint8_t next_key_id = 0;     // shared by all schedules, so (node, key_id) is unique on the BR
+
+/* One-shot timer armed to the earliest poll or heartbeat; the callback only
+   flags the main loop */
+static sl_sleeptimer_timer_handle_t poll_timer;
+static volatile bool poll_due = false;
+
+static void poll_timer_cb(sl_sleeptimer_timer_handle_t *h, void *ctx)
+{
+    (void)h; (void)ctx;
+    poll_due = true;
+}
+
+static void rearm(void)
+{
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    bool any = false;
+    uint32_t wait = 0;
+
+    for (int i = 0; i < NR_POLL_MAX; i++) {
+        nr_poll_t *p = &polls[i];
+        if (!p->used) continue;
+        int32_t d = (int32_t)(p->next_poll_tick - now);
+        if (p->heartbeat_ticks) {
+            int32_t h = (int32_t)(p->next_hb_tick - now);
+            if (h < d) d = h;
+        }
+        if (d < 0) d = 0;
+        if (!any || (uint32_t)d < wait) wait = (uint32_t)d;
+        any = true;
+    }
+
+    sl_sleeptimer_stop_timer(&poll_timer);
+    if (!any) return;
+    if (wait == 0) {
+        poll_due = true;
+        return;
+    }
+    sl_sleeptimer_start_timer(&poll_timer, wait, poll_timer_cb, NULL, 0, 0);
+}
+
+static nr_poll_t *find(const uint8_t *req, uint16_t req_len)
+{
+    for (int i = 0; i < NR_POLL_MAX; i++) {
+        if (polls[i].used && polls[i].req_len == req_len &&
+            memcmp(polls[i].req, req, req_len) == 0) {
+            return &polls[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t get_le16(const uint8_t *p)
+{
+    return (uint32_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t s_to_ticks(uint32_t s)
+{
+    return s * sl_sleeptimer_get_timer_frequency();
+}
+
+void nr_poll_init(void)
+{
+    memset(polls, 0, sizeof(polls));
+    poll_due = false;
+}
+
+int nr_poll_install(const uint8_t br_ipv6[16], const uint8_t *sched, uint8_t sched_len,
+                    const uint8_t *req, uint16_t req_len, uint32_t first_delay_ms)
+{
+    if (sched_len < METER_SCHEDULE_LEN || sched[6] > 4 || req_len > NR_POLL_REQ_MAX) {
+        LOG_WARN("[NR] bad poll schedule");
+        return -1;
+    }
+
+    uint32_t interval_s = get_le16(&sched[0]);
+    nr_poll_t *p = find(req, req_len);
+    if (interval_s == 0) {
+        if (p) {
+            p->used = false;
+            LOG_INFO("[NR] poll schedule cancelled");
+            rearm();
+        }
+        return 0;
+    }
+    if (!p) {
+        for (int i = 0; i < NR_POLL_MAX && !p; i++) {
+            if (!polls[i].used) p = &polls[i];
+        }
+        if (!p) {
+            LOG_WARN("[NR] no free poll schedule");
+            return -1;
+        }
+    }
+
+    memset(p, 0, sizeof(*p));
+    p->used = true;
+    memcpy(p->br_ipv6, br_ipv6, 16);
+    p->interval_ticks = s_to_ticks(interval_s);
+    p->heartbeat_ticks = s_to_ticks(get_le16(&sched[2]));
+    p->val_off = (uint16_t)get_le16(&sched[4]);
+    p->val_len = sched[6];
+    p->threshold = get_le16(&sched[7]) | (get_le16(&sched[9]) << 16);
+    p->layout = sched[11];
+    p->req_len = req_len;
+    memcpy(p->req, req, req_len);
+
+    /* Offset by our reply slot so NRs given the same schedule don't all read
+       and report at the same instant */
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    p->next_poll_tick = now + p->interval_ticks + sl_sleeptimer_ms_to_tick((uint16_t)first_delay_ms);
+    p->next_hb_tick = now + p->heartbeat_ticks;
+
+    LOG_INFO("[NR] poll schedule every %lus, heartbeat %lus",
+             (unsigned long)interval_s, (unsigned long)get_le16(&sched[2]));
+    rearm();
+    return 0;
+}
+
+static uint32_t reply_value(const nr_poll_t *p, const uint8_t *data, uint16_t len, bool *ok)
+{
+    uint32_t v = 0;
+    *ok = (uint32_t)p->val_off + p->val_len <= len;
+    if (!*ok) return 0;
+    for (uint8_t i = 0; i < p->val_len; i++) {
+        v = (v << 8) | data[p->val_off + i];
+    }
+    return v;
+}
+
+/* Report payload: the raw frame, or with a layout a keyframe / delta against it */
+static bool build_report(nr_poll_t *p, nr_meter_txn_t *txn, const uint8_t *data, uint16_t len)
+{
+    meter_hdr_t hdr = {
+        .type = METER_MSG_REPORT,
+        .txn_id = METER_TXN_NONE,
+    };
+    uint8_t *out = &txn->msg[METER_HDR_BASE_LEN];
+    uint16_t cap = (uint16_t)(sizeof(txn->msg) - METER_HDR_BASE_LEN);
+    uint16_t body = 0;
+
+    if (p->layout != METER_LAYOUT_RAW && p->key_len && p->key_uses < NR_POLL_KEY_INTERVAL) {
+        int n = meter_delta_encode(p->layout, p->key, p->key_len, data, len, &out[2], (uint16_t)(cap - 2));
+        if (n >= 0) {
+            hdr.flags = METER_F_DELTA;
+            out[0] = p->layout;
+            out[1] = p->key_id;
+            body = (uint16_t)(2 + n);
+            p->key_uses++;
+        }
+    }
+    if (!body && p->layout != METER_LAYOUT_RAW && len <= METER_DELTA_FRAME_MAX) {
+        hdr.flags = METER_F_KEYFRAME;
+        p->key_id = next_key_id++;
+        p->key_uses = 0;
+        p->key_len = len;
+        memcpy(p->key, data, len);
+        out[0] = p->layout;
+        out[1] = p->key_id;
+        memcpy(&out[2], data, len);
+        body = (uint16_t)(2 + len);
+    }
+    if (!body) {
+        if (len > cap) len = cap;
+        memcpy(out, data, len);
+        body = len;
+    }
+
+    if (meter_hdr_encode(txn->msg, METER_HDR_BASE_LEN, &hdr) < 0) return false;
+    txn->msg_len = (uint16_t)(METER_HDR_BASE_LEN + body);
+    return true;
+}
+
+void nr_poll_on_reply(nr_meter_txn_t *txn, const uint8_t *data, uint16_t len)
+{
+    nr_poll_t *p = find(txn->req, txn->req_len);
+    if (!p) return;     // cancelled while on the bus
+    p->answered++;
+
+    uint16_t crc = crc16_update(CRC16_INIT, data, len);
+    bool changed;
+    uint32_t val = 0;
+    if (p->val_len) {
+        bool ok;
+        val = reply_value(p, data, len, &ok);
+        if (!ok) {
+            LOG_WARN("[NR] scheduled reply too short for value, len=%u", (unsigned)len);
+            return;
+        }
+        uint32_t delta = (val > p->last_val) ? val - p->last_val : p->last_val - val;
+        changed = !p->reported || (delta >= p->threshold && delta != 0);
+    } else {
+        changed = !p->reported || crc != p->last_crc;
+    }
+    p->last_crc = crc;
+    if (!changed) return;
+
+    if (!build_report(p, txn, data, len)) return;
+
+    p->reported = true;
+    p->last_val = val;
+    p->reports++;
+}
+
+void nr_poll_on_key_nack(const uint8_t br_ipv6[16], const uint8_t *payload, uint16_t len)
+{
+    if (len < 1) return;
+    for (int i = 0; i < NR_POLL_MAX; i++) {
+        nr_poll_t *p = &polls[i];
+        if (!p->used || !p->key_len || p->key_id != payload[0] ||
+            memcmp(p->br_ipv6, br_ipv6, 16) != 0) {
+            continue;
+        }
+        LOG_INFO("[NR] BR lost keyframe %u, resending", (unsigned)p->key_id);
+        p->key_len = 0;
+        p->reported = false;                // report the next reading whatever it is
+        p->next_poll_tick = sl_sleeptimer_get_tick_count();
+        rearm();
+        return;
+    }
+}
+
+static void send_heartbeat(nr_poll_t *p)
+{
+    uint8_t msg[METER_HDR_BASE_LEN + 8];
+    meter_hdr_t hdr = {
+        .type = METER_MSG_REPORT,
+        .flags = METER_F_HEARTBEAT,
+        .txn_id = METER_TXN_NONE,
+    };
+    int hlen = meter_hdr_encode(msg, sizeof(msg), &hdr);
+    if (hlen < 0) return;
+    uint8_t *d = &msg[hlen];
+    d[0] = (uint8_t)(p->polls & 0xFF);    d[1] = (uint8_t)(p->polls >> 8);
+    d[2] = (uint8_t)(p->answered & 0xFF); d[3] = (uint8_t)(p->answered >> 8);
+    d[4] = (uint8_t)(p->reports & 0xFF);  d[5] = (uint8_t)(p->reports >> 8);
+    d[6] = (uint8_t)(p->last_crc & 0xFF); d[7] = (uint8_t)(p->last_crc >> 8);
+
+    int rc = wsun_send_unicast(p->br_ipv6, METER_UDP_PORT, msg, (uint16_t)(hlen + 8));
+    if (rc != 0) {
+        LOG_ERROR("[NR] heartbeat send failed rc=%d", rc);
+    }
+}
+
+void nr_poll_process(void)
+{
+    if (!poll_due) return;
+    poll_due = false;
+
+    uint32_t now = sl_sleeptimer_get_tick_count();
+    for (int i = 0; i < NR_POLL_MAX; i++) {
+        nr_poll_t *p = &polls[i];
+        if (!p->used) continue;
+
+        if ((int32_t)(now - p->next_poll_tick) >= 0) {
+            p->next_poll_tick += p->interval_ticks;
+            if ((int32_t)(now - p->next_poll_tick) >= 0) p->next_poll_tick = now + p->interval_ticks;
+            /* No radio reply slot: the reply callback decides whether to report */
+            if (nr_meter_q_push(METER_TXN_NONE, p->br_ipv6, p->req, p->req_len, 0, NULL) == 0) {
+                p->polls++;
+            }
+        }
+        if (p->heartbeat_ticks && (int32_t)(now - p->next_hb_tick) >= 0) {
+            p->next_hb_tick = now + p->heartbeat_ticks;
+            send_heartbeat(p);
+        }
+    }
+    rearm();
+}
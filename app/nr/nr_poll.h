@@ -0,0 +1,58 @@
+#ifndef NR_POLL_H
+#define NR_POLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nr_meter_q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Concurrent polling schedules (e.g. one per meter on the segment) */
+#ifndef NR_POLL_MAX
+#define NR_POLL_MAX 4
+#endif
+
+/* Largest request template a schedule can hold */
+#ifndef NR_POLL_REQ_MAX
+#define NR_POLL_REQ_MAX 32
+#endif
+
+/* Reports delta coded against the same keyframe before a new one is sent */
+#ifndef NR_POLL_KEY_INTERVAL
+#define NR_POLL_KEY_INTERVAL 16
+#endif
+
+void nr_poll_init(void);
+
+/**
+ * Install (or, with interval 0, cancel) a schedule from a METER_OPT_SCHEDULE
+ * value. A schedule with the same request template is replaced. Reports go
+ * to br_ipv6; the first poll is one interval plus first_delay_ms from now.
+ * Returns 0, or -1 if the option is malformed or all schedules are in use.
+ */
+int nr_poll_install(const uint8_t br_ipv6[16], const uint8_t *sched, uint8_t sched_len,
+                    const uint8_t *req, uint16_t req_len, uint32_t first_delay_ms);
+
+/**
+ * Meter answered a scheduled poll (txn_id METER_TXN_NONE): build a REPORT
+ * into txn->msg if the value changed enough, otherwise leave msg_len at 0.
+ */
+void nr_poll_on_reply(nr_meter_txn_t *txn, const uint8_t *data, uint16_t len);
+
+/**
+ * KEY_NACK from br_ipv6: it holds no keyframe for the schedule reporting
+ * with key_id. That schedule drops its keyframe and polls right away, so
+ * the next report is a fresh keyframe.
+ */
+void nr_poll_on_key_nack(const uint8_t br_ipv6[16], const uint8_t *payload, uint16_t len);
+
+/** Main-loop service: queue due polls and send heartbeats */
+void nr_poll_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NR_POLL_H
@@ -0,0 +1,53 @@
+#include "nr_reply_sched.h"
+#include "stack_if.h"
+#include "log.h"
+#include <string.h>
+
+static uint32_t rng_state = 0;
+
+static uint32_t node_hash(const uint8_t iid[8])
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 8; i++) {
+        h = (h ^ iid[i]) * 16777619u;
+    }
+    return h;
+}
+
+/* xorshift32; seeded from the node ID so neighbours do not share a sequence */
+static uint32_t rng_next(uint32_t seed)
+{
+    if (rng_state == 0) rng_state = seed ? seed : 0x9E3779B9u;
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+uint32_t nr_reply_sched_delay_ms(uint16_t window_ms, uint16_t slots)
+{
+    if (window_ms == 0 || slots == 0) return 0;
+
+    uint8_t own_ipv6[16] = {0};
+    (void)wsun_get_global_ipv6(own_ipv6);
+    uint32_t h = node_hash(&own_ipv6[8]);
+
+    uint16_t bands = (slots >= NR_REPLY_RANK_BANDS) ? NR_REPLY_RANK_BANDS : 1;
+    uint16_t band = 0;
+    uint16_t rank, min_hop_inc;
+    if (bands > 1 && wsun_get_rpl_rank(&rank, &min_hop_inc) == 0 && min_hop_inc != 0) {
+        uint16_t hops = (uint16_t)(rank / min_hop_inc);
+        if (hops == 0) hops = 1;
+        /* deepest nodes -> band 0 */
+        band = (hops >= bands) ? 0 : (uint16_t)(bands - hops);
+    }
+
+    uint16_t per_band = (uint16_t)(slots / bands);
+    uint16_t slot = (uint16_t)(band * per_band + (h % per_band));
+    uint32_t slot_ms = window_ms / slots;
+    uint32_t jitter = slot_ms ? rng_next(h) % slot_ms : 0;
+
+    LOG_DEBUG("[NR] reply slot %u/%u band %u jitter %lu ms",
+              (unsigned)slot, (unsigned)slots, (unsigned)band, (unsigned long)jitter);
+    return slot * slot_ms + jitter;
+}
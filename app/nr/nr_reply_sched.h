@@ -0,0 +1,31 @@
+#ifndef NR_REPLY_SCHED_H
+#define NR_REPLY_SCHED_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of rank bands the reply window is split into */
+#ifndef NR_REPLY_RANK_BANDS
+#define NR_REPLY_RANK_BANDS 4
+#endif
+
+/**
+ * Pick this node's reply delay (ms after the request was received) inside a
+ * window of window_ms divided into slots.
+ *
+ * The window is split into rank bands; nodes further from the BR get the
+ * earlier bands so their multi-hop replies are relayed before the nodes
+ * close to the BR start sending their own. Inside a band the slot comes from
+ * the node's interface ID, and a random jitter within the slot breaks ties.
+ * Returns 0 when no window was advertised.
+ */
+uint32_t nr_reply_sched_delay_ms(uint16_t window_ms, uint16_t slots);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NR_REPLY_SCHED_H
@@ -15,3 +15,19 @@
 // SWD
 #define PIN_SWDCLK      PA18
 #define PIN_SWDDIO      PA19
+
+// RS-485 as port/pin pairs for uart485_config_t
+#define RS485_EUSART    EUSART1
+#define RS485_TX_PORT   gpioPortC
+#define RS485_TX_PIN    5
+#define RS485_RX_PORT   gpioPortC
+#define RS485_RX_PIN    6
+#define RS485_RTS_PORT  gpioPortC
+#define RS485_RTS_PIN   4
+
+// Debug UART as port/pin pairs for uart_config_t
+#define DEBUG_EUSART    EUSART0
+#define DEBUG_TX_PORT   gpioPortA
+#define DEBUG_TX_PIN    8
+#define DEBUG_RX_PORT   gpioPortA
+#define DEBUG_RX_PIN    9
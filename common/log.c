@@ -1,8 +1,28 @@
 #include "log.h"
 #include "uart.h"   // default backend over UART0
+#include "pins.h"
+
+static const uart_config_t debug_cfg = {
+    .eusart   = DEBUG_EUSART,
+    .tx_port  = DEBUG_TX_PORT, .tx_pin = DEBUG_TX_PIN,
+    .rx_port  = DEBUG_RX_PORT, .rx_pin = DEBUG_RX_PIN,
+    .baudrate = 115200,
+};
 
 void log_init(void)
 {
-    uart0_init(115200);    // simple debug UART
+    uart_init(&debug_cfg);    // simple debug UART
     LOG_INFO("Logger initialized");
 }
+
+/* newlib printf backend: queue for the UART TX interrupt and return at once.
+   Lines that don't fit outside the host-link reserve are cut short and
+   counted by uart_tx_dropped(). */
+int _write(int fd, const char *buf, int len)
+{
+    (void)fd;
+    if (len <= 0) return 0;
+    if (len > UINT16_MAX) len = UINT16_MAX;
+    uart_log_write((const uint8_t *)buf, (uint16_t)len);
+    return len;
+}
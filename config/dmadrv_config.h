@@ -0,0 +1,22 @@
+#ifndef DMADRV_CONFIG_H
+#define DMADRV_CONFIG_H
+
+/* DMADRV settings for this project (read by dmadrv.h) */
+
+/* LDMA interrupt priority; the RS-485 RX interrupt runs at the same level
+   so a flush and a ping-pong buffer switch never interleave */
+#ifndef EMDRV_DMADRV_DMA_IRQ_PRIORITY
+#define EMDRV_DMADRV_DMA_IRQ_PRIORITY 3
+#endif
+
+/* Channels DMADRV may hand out: two per EUSART port using DMA */
+#ifndef EMDRV_DMADRV_DMA_CH_COUNT
+#define EMDRV_DMADRV_DMA_CH_COUNT 8
+#endif
+
+/* Channels 0..n-1 use fixed arbitration priority, the rest round robin */
+#ifndef EMDRV_DMADRV_DMA_CH_PRIORITY
+#define EMDRV_DMADRV_DMA_CH_PRIORITY 0
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+#include "eusart.h"
+#include "em_cmu.h"
+#include "em_core.h"
+#include "em_device.h"
+#include "log.h"
+
+/* What differs between instances, indexed by EUSART_NUM() */
+typedef struct {
+    EUSART_TypeDef *eusart;
+    CMU_Clock_TypeDef clock;
+    IRQn_Type rx_irqn;
+    IRQn_Type tx_irqn;
+    DMADRV_PeripheralSignal_t tx_signal;
+    DMADRV_PeripheralSignal_t rx_signal;
+} eusart_instance_t;
+
+static const eusart_instance_t instances[EUSART_COUNT] = {
+    { EUSART0, cmuClock_EUSART0, EUSART0_RX_IRQn, EUSART0_TX_IRQn,
+      dmadrvPeripheralSignal_EUSART0_TXBL, dmadrvPeripheralSignal_EUSART0_RXDATAV },
+#if EUSART_COUNT > 1
+    { EUSART1, cmuClock_EUSART1, EUSART1_RX_IRQn, EUSART1_TX_IRQn,
+      dmadrvPeripheralSignal_EUSART1_TXBL, dmadrvPeripheralSignal_EUSART1_RXDATAV },
+#endif
+#if EUSART_COUNT > 2
+    { EUSART2, cmuClock_EUSART2, EUSART2_RX_IRQn, EUSART2_TX_IRQn,
+      dmadrvPeripheralSignal_EUSART2_TXBL, dmadrvPeripheralSignal_EUSART2_RXDATAV },
+#endif
+#if EUSART_COUNT > 3
+    { EUSART3, cmuClock_EUSART3, EUSART3_RX_IRQn, EUSART3_TX_IRQn,
+      dmadrvPeripheralSignal_EUSART3_TXBL, dmadrvPeripheralSignal_EUSART3_RXDATAV },
+#endif
+#if EUSART_COUNT > 4
+    { EUSART4, cmuClock_EUSART4, EUSART4_RX_IRQn, EUSART4_TX_IRQn,
+      dmadrvPeripheralSignal_EUSART4_TXBL, dmadrvPeripheralSignal_EUSART4_RXDATAV },
+#endif
+};
+
+static eusart_port_t *ports[EUSART_COUNT];
+
+int eusart_port_init(eusart_port_t *port, const eusart_config_t *cfg)
+{
+    int idx = -1;
+    for (int i = 0; i < EUSART_COUNT; i++) {
+        if (instances[i].eusart == cfg->eusart) idx = i;
+    }
+    if (idx < 0) return -1;
+    const eusart_instance_t *inst = &instances[idx];
+
+    port->eusart = cfg->eusart;
+    port->idx = (uint8_t)idx;
+    ring_init(&port->rx, cfg->rx_buf, cfg->rx_size);
+    ring_init(&port->tx, cfg->tx_buf, cfg->tx_size);
+    port->rx_fifo_overruns = 0;
+    port->rx_hook = cfg->rx_hook;
+    port->tx_hook = cfg->tx_hook;
+    port->user = cfg->user;
+
+    CMU_ClockEnable(inst->clock, true);
+    CMU_ClockEnable(cmuClock_GPIO, true);
+
+    // TX, RX pins
+    GPIO_PinModeSet(cfg->tx_port, cfg->tx_pin, gpioModePushPull, 1);
+    GPIO_PinModeSet(cfg->rx_port, cfg->rx_pin,
+                    cfg->rx_filter ? gpioModeInputPullFilter : gpioModeInputPull, 1);
+
+    GPIO->EUSARTROUTE[idx].TXROUTE =
+        (cfg->tx_port << _GPIO_EUSART_TXROUTE_PORT_SHIFT) |
+        (cfg->tx_pin  << _GPIO_EUSART_TXROUTE_PIN_SHIFT);
+    GPIO->EUSARTROUTE[idx].RXROUTE =
+        (cfg->rx_port << _GPIO_EUSART_RXROUTE_PORT_SHIFT) |
+        (cfg->rx_pin  << _GPIO_EUSART_RXROUTE_PIN_SHIFT);
+    GPIO->EUSARTROUTE[idx].ROUTEEN =
+        GPIO_EUSART_ROUTEEN_TXPEN | GPIO_EUSART_ROUTEEN_RXPEN;
+
+    EUSART_UartInit_TypeDef init = EUSART_UART_INIT_DEFAULT_HF;
+    init.baudrate = cfg->baudrate;
+    init.parity   = eusartNoParity;
+    init.stopbits = eusartStopbits1;
+    init.databits = eusartDataBits8;
+
+    EUSART_UartInitHf(port->eusart, &init);
+
+    ports[idx] = port;
+
+    // Byte-wise RX through the core unless the owner runs RX DMA; TXFL is enabled per write
+    if (cfg->rx_buf && !cfg->rx_by_dma) EUSART_IntEnable(port->eusart, EUSART_IEN_RXFL);
+    NVIC_ClearPendingIRQ(inst->rx_irqn);
+    NVIC_ClearPendingIRQ(inst->tx_irqn);
+    NVIC_EnableIRQ(inst->rx_irqn);
+    NVIC_EnableIRQ(inst->tx_irqn);
+    return 0;
+}
+
+int eusart_dma_alloc(eusart_port_t *port)
+{
+    // DMADRV may already be up for another port
+    Ecode_t ec = DMADRV_Init();
+    if (ec != ECODE_EMDRV_DMADRV_OK && ec != ECODE_EMDRV_DMADRV_ALREADY_INITIALIZED) {
+        LOG_ERROR("[EUSART%u] DMADRV init failed, ecode=0x%lx", (unsigned)port->idx, (unsigned long)ec);
+        return -1;
+    }
+    ec = DMADRV_AllocateChannel(&port->tx_dma_ch, NULL);
+    if (ec != ECODE_EMDRV_DMADRV_OK) {
+        LOG_ERROR("[EUSART%u] no TX DMA channel, ecode=0x%lx", (unsigned)port->idx, (unsigned long)ec);
+        return -1;
+    }
+    ec = DMADRV_AllocateChannel(&port->rx_dma_ch, NULL);
+    if (ec != ECODE_EMDRV_DMADRV_OK) {
+        LOG_ERROR("[EUSART%u] no RX DMA channel, ecode=0x%lx", (unsigned)port->idx, (unsigned long)ec);
+        DMADRV_FreeChannel(port->tx_dma_ch);
+        return -1;
+    }
+    return 0;
+}
+
+DMADRV_PeripheralSignal_t eusart_dma_tx_signal(const eusart_port_t *port)
+{
+    return instances[port->idx].tx_signal;
+}
+
+DMADRV_PeripheralSignal_t eusart_dma_rx_signal(const eusart_port_t *port)
+{
+    return instances[port->idx].rx_signal;
+}
+
+IRQn_Type eusart_rx_irqn(const eusart_port_t *port)
+{
+    return instances[port->idx].rx_irqn;
+}
+
+IRQn_Type eusart_tx_irqn(const eusart_port_t *port)
+{
+    return instances[port->idx].tx_irqn;
+}
+
+uint32_t eusart_rx_overflows(const eusart_port_t *port)
+{
+    return port->rx.dropped + port->rx_fifo_overruns;
+}
+
+uint16_t eusart_write(eusart_port_t *port, const uint8_t *data, uint16_t len)
+{
+    return eusart_write_keep(port, data, len, 0);
+}
+
+uint16_t eusart_write_keep(eusart_port_t *port, const uint8_t *data, uint16_t len, uint16_t keep_free)
+{
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_ATOMIC();
+    uint16_t free = ring_free(&port->tx);
+    uint16_t room = free > keep_free ? (uint16_t)(free - keep_free) : 0;
+    uint16_t n = ring_write(&port->tx, data, len < room ? len : room);
+    port->tx.dropped += (uint32_t)(len - n);
+    CORE_EXIT_ATOMIC();
+
+    if (n && port->eusart) EUSART_IntEnable(port->eusart, EUSART_IEN_TXFL);
+    return n;
+}
+
+static void rx_dispatch(unsigned int idx)
+{
+    eusart_port_t *p = ports[idx];
+    if (!p) return;
+
+    uint32_t flags = EUSART_IntGetEnabled(p->eusart) & ~EUSART_TX_IRQ_FLAGS;
+    EUSART_IntClear(p->eusart, flags);
+
+    if (flags & EUSART_IF_RXFL) {
+        while (p->eusart->STATUS & EUSART_STATUS_RXFL) {
+            uint8_t b = (uint8_t)p->eusart->RXDATA;
+            ring_write(&p->rx, &b, 1);
+        }
+        flags &= ~EUSART_IF_RXFL;
+    }
+    if (flags & EUSART_IF_RXOF) p->rx_fifo_overruns++;
+    if (flags && p->rx_hook) p->rx_hook(p, flags);
+}
+
+static void tx_dispatch(unsigned int idx)
+{
+    eusart_port_t *p = ports[idx];
+    if (!p) return;
+
+    uint32_t flags = EUSART_IntGetEnabled(p->eusart) & EUSART_TX_IRQ_FLAGS;
+
+    if (flags & EUSART_IF_TXFL) {
+        EUSART_IntClear(p->eusart, EUSART_IF_TXFL);
+        const uint8_t *span;
+        uint16_t n;
+        while ((n = ring_peek(&p->tx, &span)) != 0) {
+            uint16_t i = 0;
+            while (i < n && (p->eusart->STATUS & EUSART_STATUS_TXFL)) {
+                p->eusart->TXDATA = span[i++];
+            }
+            ring_consume(&p->tx, i);
+            if (i < n) break;                           // FIFO full, wait for TXFL
+        }
+        if (ring_used(&p->tx) == 0) EUSART_IntDisable(p->eusart, EUSART_IEN_TXFL);
+        flags &= ~EUSART_IF_TXFL;
+    }
+    // The rest (TXC, ...) is the owner's to clear: it may need the flag state
+    if (flags && p->tx_hook) p->tx_hook(p, flags);
+}
+
+void EUSART0_RX_IRQHandler(void) { rx_dispatch(0); }
+void EUSART0_TX_IRQHandler(void) { tx_dispatch(0); }
+#if EUSART_COUNT > 1
+void EUSART1_RX_IRQHandler(void) { rx_dispatch(1); }
+void EUSART1_TX_IRQHandler(void) { tx_dispatch(1); }
+#endif
+#if EUSART_COUNT > 2
+void EUSART2_RX_IRQHandler(void) { rx_dispatch(2); }
+void EUSART2_TX_IRQHandler(void) { tx_dispatch(2); }
+#endif
+#if EUSART_COUNT > 3
+void EUSART3_RX_IRQHandler(void) { rx_dispatch(3); }
+void EUSART3_TX_IRQHandler(void) { tx_dispatch(3); }
+#endif
+#if EUSART_COUNT > 4
+void EUSART4_RX_IRQHandler(void) { rx_dispatch(4); }
+void EUSART4_TX_IRQHandler(void) { tx_dispatch(4); }
+#endif
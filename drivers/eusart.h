@@ -0,0 +1,87 @@
+#ifndef EUSART_H
+#define EUSART_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "em_eusart.h"
+#include "em_gpio.h"
+#include "dmadrv.h"
+#include "ring.h"
+
+/* Shared EUSART core: pin routing, clocks, NVIC and LDMA wiring per
+   instance, plus the byte rings the interrupt handlers fill and drain.
+   Each EUSART in use is described by one eusart_port_t; the IRQ handlers
+   of every instance dispatch to the port opened on it. */
+
+/* Interrupt flags that are raised on the TX line; everything else is RX */
+#define EUSART_TX_IRQ_FLAGS (EUSART_IF_TXC | EUSART_IF_TXFL | EUSART_IF_TXOF | \
+                             EUSART_IF_TXUF | EUSART_IF_TXIDLE)
+
+typedef struct eusart_port eusart_port_t;
+
+/* Interrupt context: enabled flags the core did not consume itself */
+typedef void (*eusart_irq_hook_t)(eusart_port_t *port, uint32_t flags);
+
+typedef struct {
+    EUSART_TypeDef *eusart;
+    GPIO_Port_TypeDef tx_port;
+    uint8_t tx_pin;
+    GPIO_Port_TypeDef rx_port;
+    uint8_t rx_pin;
+    bool rx_filter;             // glitch filter on the RX input
+    uint32_t baudrate;
+
+    /* Rings, sizes power of two; tx_buf NULL when the owner drives TX itself */
+    uint8_t *rx_buf;
+    uint16_t rx_size;
+    uint8_t *tx_buf;
+    uint16_t tx_size;
+    bool rx_by_dma;             // owner fills the RX ring itself, no RXFL
+
+    eusart_irq_hook_t rx_hook;
+    eusart_irq_hook_t tx_hook;
+    void *user;
+} eusart_config_t;
+
+struct eusart_port {
+    EUSART_TypeDef *eusart;
+    uint8_t idx;
+
+    ring_t rx;                  // dropped counts a full ring
+    ring_t tx;
+    volatile uint32_t rx_fifo_overruns;
+
+    unsigned int tx_dma_ch;
+    unsigned int rx_dma_ch;
+
+    eusart_irq_hook_t rx_hook;
+    eusart_irq_hook_t tx_hook;
+    void *user;
+};
+
+/* Bring up the instance in cfg and attach port to its interrupts.
+   Returns -1 for an instance this device doesn't have. */
+int eusart_port_init(eusart_port_t *port, const eusart_config_t *cfg);
+
+/* Allocate one TX and one RX LDMA channel for the port; logs and returns -1
+   on failure, holding no channel */
+int eusart_dma_alloc(eusart_port_t *port);
+DMADRV_PeripheralSignal_t eusart_dma_tx_signal(const eusart_port_t *port);
+DMADRV_PeripheralSignal_t eusart_dma_rx_signal(const eusart_port_t *port);
+
+IRQn_Type eusart_rx_irqn(const eusart_port_t *port);
+IRQn_Type eusart_tx_irqn(const eusart_port_t *port);
+
+/* RX bytes lost so far: full ring plus EUSART FIFO overruns */
+uint32_t eusart_rx_overflows(const eusart_port_t *port);
+
+/* TX ring: queues what fits, drops and counts the rest, never waits.
+   Safe from any context; the ring's single producer is enforced here. */
+uint16_t eusart_write(eusart_port_t *port, const uint8_t *data, uint16_t len);
+
+/* As eusart_write(), but never lets free space drop below keep_free: a
+   lower-priority writer cannot take the room kept for another one */
+uint16_t eusart_write_keep(eusart_port_t *port, const uint8_t *data, uint16_t len, uint16_t keep_free);
+
+#endif
@@ -0,0 +1,88 @@
+#include "ring.h"
+#include "em_device.h"
+#include <string.h>
+
+void ring_init(ring_t *r, uint8_t *buf, uint16_t size)
+{
+    r->buf = buf;
+    r->mask = (uint16_t)(size - 1);
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+}
+
+uint16_t ring_used(const ring_t *r)
+{
+    return (uint16_t)(r->head - r->tail);
+}
+
+uint16_t ring_free(const ring_t *r)
+{
+    if (!r->buf) return 0;
+    return (uint16_t)(r->mask + 1 - ring_used(r));
+}
+
+uint16_t ring_peek(const ring_t *r, const uint8_t **span)
+{
+    uint16_t t = r->tail;
+    uint16_t used = (uint16_t)(r->head - t);
+    __DMB();    // head seen before the data it covers is read
+    uint16_t off = t & r->mask;
+    uint16_t run = (uint16_t)(r->mask + 1 - off);
+    *span = &r->buf[off];
+    return used < run ? used : run;
+}
+
+void ring_consume(ring_t *r, uint16_t n)
+{
+    __DMB();    // data read before the space is handed back
+    r->tail = (uint16_t)(r->tail + n);
+}
+
+uint16_t ring_reserve(const ring_t *r, uint8_t **span)
+{
+    uint16_t h = r->head;
+    uint16_t free = ring_free(r);
+    __DMB();    // tail seen before the space it frees is written
+    uint16_t off = h & r->mask;
+    uint16_t run = (uint16_t)(r->mask + 1 - off);
+    *span = &r->buf[off];
+    return free < run ? free : run;
+}
+
+void ring_commit(ring_t *r, uint16_t n)
+{
+    __DMB();    // data written before it is published
+    r->head = (uint16_t)(r->head + n);
+}
+
+uint16_t ring_write(ring_t *r, const uint8_t *data, uint16_t len)
+{
+    uint16_t done = 0;
+    while (done < len) {
+        uint8_t *span;
+        uint16_t n = ring_reserve(r, &span);
+        if (n == 0) break;
+        if (n > len - done) n = (uint16_t)(len - done);
+        memcpy(span, &data[done], n);
+        ring_commit(r, n);
+        done = (uint16_t)(done + n);
+    }
+    r->dropped += (uint32_t)(len - done);
+    return done;
+}
+
+uint16_t ring_read(ring_t *r, uint8_t *out, uint16_t len)
+{
+    uint16_t done = 0;
+    while (done < len) {
+        const uint8_t *span;
+        uint16_t n = ring_peek(r, &span);
+        if (n == 0) break;
+        if (n > len - done) n = (uint16_t)(len - done);
+        memcpy(&out[done], span, n);
+        ring_consume(r, n);
+        done = (uint16_t)(done + n);
+    }
+    return done;
+}
@@ -0,0 +1,43 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Lock-free single-producer/single-consumer byte ring.
+   Capacity is a power of two up to 32768; head and tail run freely and are
+   masked only on access, so all of it is usable and used = head - tail.
+   Only the producer writes head and only the consumer writes tail; a
+   barrier orders the data against each index update. Producer and consumer
+   may be an interrupt and the main loop; several producers (or consumers)
+   need their own critical section around the calls. */
+typedef struct {
+    uint8_t *buf;
+    uint16_t mask;
+    volatile uint16_t head;     // producer
+    volatile uint16_t tail;     // consumer
+    volatile uint32_t dropped;  // bytes refused by ring_write() on a full ring
+} ring_t;
+
+void ring_init(ring_t *r, uint8_t *buf, uint16_t size);
+uint16_t ring_used(const ring_t *r);
+uint16_t ring_free(const ring_t *r);
+
+/* Producer: copy in what fits, drop and count the rest; returns bytes written */
+uint16_t ring_write(ring_t *r, const uint8_t *data, uint16_t len);
+
+/* Consumer: copy out up to len bytes; returns bytes read */
+uint16_t ring_read(ring_t *r, uint8_t *out, uint16_t len);
+
+/* Consumer, zero-copy: *span points at the longest contiguous readable run,
+   whose length is returned (0 if empty). Release it with ring_consume(). */
+uint16_t ring_peek(const ring_t *r, const uint8_t **span);
+void ring_consume(ring_t *r, uint16_t n);
+
+/* Producer, zero-copy: *span points at the longest contiguous free run,
+   whose length is returned. Publish what was filled with ring_commit(). */
+uint16_t ring_reserve(const ring_t *r, uint8_t **span);
+void ring_commit(ring_t *r, uint16_t n);
+
+#endif
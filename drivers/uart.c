@@ -1,87 +1,73 @@
 #include "uart.h"
-#include "em_cmu.h"
-#include "em_device.h"
+#include "eusart.h"
 
-static EUSART_TypeDef *g_uart;
-static volatile uint8_t rx_buffer[256];
-static volatile uint16_t rx_head = 0;
-static volatile uint16_t rx_tail = 0;
+static eusart_port_t uart_port;
+static uint8_t rx_buffer[UART_RX_RING_SIZE];
+static uint8_t tx_ring[UART_TX_RING_SIZE];
+static volatile bool log_held;
 
 void uart_init(const uart_config_t *cfg)
 {
-    g_uart = cfg->eusart;
-
-    // --- Enable EUSART clock ---
-    if (g_uart == EUSART0) {
-        CMU_ClockEnable(cmuClock_EUSART0, true);
-    } else if (g_uart == EUSART1) {
-        CMU_ClockEnable(cmuClock_EUSART1, true);
-    }
-
-    CMU_ClockEnable(cmuClock_GPIO, true);
-
-    // --- Configure GPIO pins ---
-    GPIO_PinModeSet(cfg->tx_port, cfg->tx_pin, gpioModePushPull, 1);
-    GPIO_PinModeSet(cfg->rx_port, cfg->rx_pin, gpioModeInputPull, 1);
+    const eusart_config_t ecfg = {
+        .eusart   = cfg->eusart,
+        .tx_port  = cfg->tx_port, .tx_pin = cfg->tx_pin,
+        .rx_port  = cfg->rx_port, .rx_pin = cfg->rx_pin,
+        .baudrate = cfg->baudrate,
+        .rx_buf   = rx_buffer, .rx_size = sizeof(rx_buffer),
+        .tx_buf   = tx_ring,   .tx_size = sizeof(tx_ring),
+    };
+    eusart_port_init(&uart_port, &ecfg);
+}
 
-    // Route pins to EUSART
-    uint8_t idx = EUSART_NUM(g_uart);
-    GPIO->EUSARTROUTE[idx].TXROUTE = 
-        (cfg->tx_port << _GPIO_EUSART_TXROUTE_PORT_SHIFT) |
-        (cfg->tx_pin  << _GPIO_EUSART_TXROUTE_PIN_SHIFT);
-    GPIO->EUSARTROUTE[idx].RXROUTE = 
-        (cfg->rx_port << _GPIO_EUSART_RXROUTE_PORT_SHIFT) |
-        (cfg->rx_pin  << _GPIO_EUSART_RXROUTE_PIN_SHIFT);
-    GPIO->EUSARTROUTE[idx].ROUTEEN = 
-        GPIO_EUSART_ROUTEEN_TXPEN | GPIO_EUSART_ROUTEEN_RXPEN;
+bool uart_rx_available(void)
+{
+    return ring_used(&uart_port.rx) != 0;
+}
 
-    // --- Setup UART parameters using em_eusart.h defaults ---
-    EUSART_UartInit_TypeDef init = EUSART_UART_INIT_DEFAULT_HF;
-    init.baudrate = cfg->baudrate;
-    init.parity   = eusartNoParity;
-    init.stopbits = eusartStopbits1;
-    init.databits = eusartDataBits8;
+uint8_t uart_read_byte(void)
+{
+    uint8_t b = 0;
+    ring_read(&uart_port.rx, &b, 1);
+    return b;
+}
 
-    EUSART_UartInitHf(g_uart, &init);
+uint16_t uart_rx_peek(const uint8_t **span)
+{
+    return ring_peek(&uart_port.rx, span);
+}
 
-    // --- Enable RX interrupt ---
-    EUSART_IntEnable(g_uart, EUSART_IEN_RXFL);
-    NVIC_EnableIRQ(EUSART0_RX_IRQn);   // Adjust for instance (EUSART1_RX_IRQn, etc.)
+void uart_rx_consume(uint16_t n)
+{
+    ring_consume(&uart_port.rx, n);
 }
 
-void EUSART0_RX_IRQHandler(void)
+uint16_t uart_tx_free(void)
 {
-    uint32_t flags = EUSART_IntGet(g_uart);
-    EUSART_IntClear(g_uart, flags);
+    return ring_free(&uart_port.tx);
+}
 
-    if (flags & EUSART_IF_RXFL) {
-        uint8_t b = EUSART_Rx(g_uart);
-        rx_buffer[rx_head++] = b;
-        rx_head &= 0xFF;
-    }
+uint32_t uart_tx_dropped(void)
+{
+    return uart_port.tx.dropped;
 }
 
-bool uart_rx_available(void)
+void uart_send_byte(uint8_t b)
 {
-    return rx_head != rx_tail;
+    uart_send_buffer(&b, 1);
 }
 
-uint8_t uart_read_byte(void)
+uint16_t uart_send_buffer(const uint8_t *data, uint16_t len)
 {
-    uint8_t b = rx_buffer[rx_tail++];
-    rx_tail &= 0xFF;
-    return b;
+    return eusart_write(&uart_port, data, len);
 }
 
-void uart_send_byte(uint8_t b)
+uint16_t uart_log_write(const uint8_t *data, uint16_t len)
 {
-    while (!(g_uart->STATUS & EUSART_STATUS_TXIDLE));
-    EUSART_Tx(g_uart, b);
+    // Held: nothing fits, the write is only counted as dropped
+    return eusart_write_keep(&uart_port, data, len, log_held ? UINT16_MAX : UART_TX_LOG_RESERVE);
 }
 
-void uart_send_buffer(const uint8_t *data, uint16_t len)
+void uart_log_hold(bool hold)
 {
-    for (uint16_t i = 0; i < len; i++) {
-        uart_send_byte(data[i]);
-    }
+    log_held = hold;
 }
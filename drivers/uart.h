@@ -7,6 +7,24 @@
 #include "em_eusart.h"
 #include "em_gpio.h"
 
+/* RX ring filled by the RXFL interrupt; must be a power of two. Holds a
+   whole host command, so the main loop may stall for the time one takes on
+   the wire (~350 ms at 115200) before bytes are lost. */
+#ifndef UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE 4096
+#endif
+
+/* TX ring drained by the TXFL interrupt; must be a power of two */
+#ifndef UART_TX_RING_SIZE
+#define UART_TX_RING_SIZE 4096
+#endif
+
+/* TX ring space log output may never use, so host-link frames sharing the
+   UART always find room for one full frame once the previous one drained */
+#ifndef UART_TX_LOG_RESERVE
+#define UART_TX_LOG_RESERVE 2560
+#endif
+
 typedef struct {
     EUSART_TypeDef *eusart;
     GPIO_Port_TypeDef tx_port;
@@ -17,9 +35,24 @@ typedef struct {
 } uart_config_t;
 
 void uart_init(const uart_config_t *cfg);
+
+/* Transmit never waits: bytes are queued and sent from the TX interrupt.
+   What doesn't fit is dropped and counted; returns the bytes queued. */
 void uart_send_byte(uint8_t byte);
-void uart_send_buffer(const uint8_t *data, uint16_t len);
+uint16_t uart_send_buffer(const uint8_t *data, uint16_t len);
+uint16_t uart_tx_free(void);
+
+/* Log output: like uart_send_buffer() but leaves UART_TX_LOG_RESERVE free.
+   While held, log output is dropped and counted so that it cannot land in
+   the middle of a frame being queued. */
+uint16_t uart_log_write(const uint8_t *data, uint16_t len);
+void uart_log_hold(bool hold);
+uint32_t uart_tx_dropped(void);
 uint8_t uart_read_byte(void);
 bool uart_rx_available(void);
 
+/* Received bytes in place: longest contiguous run, released with uart_rx_consume() */
+uint16_t uart_rx_peek(const uint8_t **span);
+void uart_rx_consume(uint16_t n);
+
 #endif
@@ -1,29 +1,146 @@
 #include "uart_485.h"
-#include "em_cmu.h"
+#include "eusart.h"
+#include "em_core.h"
+#include "dmadrv.h"
+#include "sl_sleeptimer.h"
+#include "log.h"
+#include <string.h>
 
+static eusart_port_t port_485;
 static EUSART_TypeDef *g_485;
 static GPIO_Port_TypeDef rts_port_g;
 static uint8_t rts_pin_g;
 
-static volatile uint8_t rx_buf_485[256];
-static volatile uint16_t rx_h_485 = 0;
-static volatile uint16_t rx_t_485 = 0;
+static uint8_t rx_buf_485[UART485_RX_RING_SIZE];
 
-void uart485_init(const uart485_config_t *cfg)
+/* Receive: LDMA ping-pongs between two buffers and each full one is
+   copied into the ring. The RX FIFO watermark is two characters, so the
+   last byte of a frame stays in the FIFO and the EUSART RX timeout fires
+   once the line has been silent for the frame gap; its handler moves the
+   partial buffer and that byte, and everything up to the head snapshot is
+   one frame. The RX timeout counts at most 7 characters; a longer gap (T3.5
+   above 19200 baud is 1750 us, ~18 characters at 115200) is finished by a
+   sleeptimer that only closes the frame if nothing arrived meanwhile. */
+static uint8_t rx_dma_buf[2][UART485_RX_DMA_BUF];
+static uint8_t rx_dma_idx = 0;          // buffer LDMA is filling
+static uint16_t rx_dma_off = 0;         // bytes of it already in the ring
+static uint32_t g_baud;
+static uint32_t gap_us_g;
+
+/* Ends of frames not yet delivered, so a second frame finishing before
+   uart485_poll() runs is not merged into the first */
+typedef struct {
+    uint16_t end;           // ring head after the frame's last byte
+    uint32_t overflows;     // eusart_rx_overflows() at that point
+    bool     merged;        // queue was full: later frames were appended
+} rx_frame_end_t;
+
+#if (UART485_FRAME_QUEUE & (UART485_FRAME_QUEUE - 1)) || UART485_FRAME_QUEUE > 128
+#error "UART485_FRAME_QUEUE must be a power of two, at most 128"
+#endif
+
+static rx_frame_end_t frame_ends[UART485_FRAME_QUEUE];
+static volatile uint8_t fe_head = 0;
+static volatile uint8_t fe_tail = 0;
+static sl_sleeptimer_timer_handle_t gap_timer;
+static uint32_t gap_ext_ticks = 0;      // gap left after the hardware RX timeout
+static volatile uint16_t gap_head = 0;  // ring head at that RX timeout
+static uint32_t overflows_seen = 0;      // eusart_rx_overflows() at the last frame end
+static uint32_t oversize_frames = 0;
+
+static uart485_rx_cb_t g_rx_cb = NULL;
+static uint8_t frame_buf[UART485_FRAME_MAX];
+
+/* Transmit: LDMA feeds the TX FIFO; when it has moved the last byte the
+   TXC interrupt is armed, and that drops DE once the shifter is empty. */
+static volatile bool tx_busy = false;
+static bool dma_ready = false;          // both channels allocated and RX running
+static uart485_tx_done_cb_t tx_done_cb = NULL;
+
+/* A ping-pong buffer is full; LDMA has already moved on to the other one */
+static bool rx_dma_done(unsigned int channel, unsigned int sequenceNo, void *userParam)
 {
-    g_485 = cfg->eusart;
+    (void)channel; (void)sequenceNo; (void)userParam;
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_ATOMIC();
+    ring_write(&port_485.rx, &rx_dma_buf[rx_dma_idx][rx_dma_off], (uint16_t)(UART485_RX_DMA_BUF - rx_dma_off));
+    rx_dma_idx ^= 1;
+    rx_dma_off = 0;
+    CORE_EXIT_ATOMIC();
+    return true;
+}
 
-    if (g_485 == EUSART0) {
-        CMU_ClockEnable(cmuClock_EUSART0, true);
-    } else if (g_485 == EUSART1) {
-        CMU_ClockEnable(cmuClock_EUSART1, true);
+/* Move what LDMA has written into the active buffer so far */
+static void rx_dma_flush(void)
+{
+    if (LDMA->IF & (1UL << port_485.rx_dma_ch)) {
+        // Buffer completed but its callback hasn't run (EUSART RX outranks
+        // LDMA on ties, or the LDMA interrupt was held off): take the
+        // completion here, LDMA may already be filling the next buffer
+        LDMA_IntClear(1UL << port_485.rx_dma_ch);
+        rx_dma_done(port_485.rx_dma_ch, 0, NULL);
     }
+    int remaining;
+    if (DMADRV_TransferRemainingCount(port_485.rx_dma_ch, &remaining) != ECODE_EMDRV_DMADRV_OK) return;
+    uint16_t filled = (uint16_t)(UART485_RX_DMA_BUF - remaining);
+    if (filled > rx_dma_off) {
+        ring_write(&port_485.rx, &rx_dma_buf[rx_dma_idx][rx_dma_off], (uint16_t)(filled - rx_dma_off));
+        rx_dma_off = filled;
+    }
+}
+
+/* Modbus T3.5: 3.5 characters of 11 bits; fixed 1750 us above 19200 baud */
+static uint32_t frame_gap_us_for(uint32_t baudrate)
+{
+    if (baudrate == 0) return 0;
+    if (baudrate > 19200) return 1750;
+    return (uint32_t)((35ULL * 11 * 1000000ULL) / (10ULL * baudrate));
+}
+
+/* The EUSART counts the RX timeout in 11-bit characters, 1..7; CFG1 is only
+   writable while the peripheral is disabled */
+static void rx_timeout_apply(void)
+{
+    if (g_baud == 0) return;
+    uint32_t char_us = (uint32_t)(11000000UL / g_baud);
+    uint32_t frames = (gap_us_g + char_us - 1) / char_us;
+    if (frames < _EUSART_CFG1_RXTIMEOUT_ONEFRAME) frames = _EUSART_CFG1_RXTIMEOUT_ONEFRAME;
+    if (frames > _EUSART_CFG1_RXTIMEOUT_SEVENFRAMES) frames = _EUSART_CFG1_RXTIMEOUT_SEVENFRAMES;
+
+    uint32_t hw_us = frames * char_us;
+    uint32_t ext_us = gap_us_g > hw_us ? gap_us_g - hw_us : 0;
+    gap_ext_ticks = (uint32_t)(((uint64_t)ext_us * sl_sleeptimer_get_timer_frequency() + 999999U) / 1000000U);
+
+    EUSART_Enable(g_485, eusartDisable);
+    g_485->CFG1 = (g_485->CFG1 & ~(_EUSART_CFG1_RXTIMEOUT_MASK | _EUSART_CFG1_RXFIW_MASK))
+                | (frames << _EUSART_CFG1_RXTIMEOUT_SHIFT)
+                | (_EUSART_CFG1_RXFIW_TWOFRAMES << _EUSART_CFG1_RXFIW_SHIFT);
+    EUSART_Enable(g_485, eusartEnable);
+}
+
+void uart485_set_frame_gap_us(uint32_t gap_us)
+{
+    gap_us_g = gap_us;
+    rx_timeout_apply();
+}
+
+uint32_t uart485_rx_overflows(void)
+{
+    return eusart_rx_overflows(&port_485);
+}
+
+uint32_t uart485_rx_activity(void)
+{
+    return (uint32_t)port_485.rx.head + eusart_rx_overflows(&port_485);
+}
 
-    CMU_ClockEnable(cmuClock_GPIO, true);
+static void rx_irq(eusart_port_t *port, uint32_t flags);
+static void tx_irq(eusart_port_t *port, uint32_t flags);
 
-    // TX, RX pins
-    GPIO_PinModeSet(cfg->tx_port, cfg->tx_pin, gpioModePushPull, 1);
-    GPIO_PinModeSet(cfg->rx_port, cfg->rx_pin, gpioModeInputPullFilter, 1);
+int uart485_init(const uart485_config_t *cfg)
+{
+    g_485 = cfg->eusart;
+    dma_ready = false;
 
     // RTS pin (DE/RE)
     rts_port_g = cfg->rts_port;
@@ -31,59 +148,220 @@ void uart485_init(const uart485_config_t *cfg)
     GPIO_PinModeSet(rts_port_g, rts_pin_g, gpioModePushPull, 0);
     GPIO_PinOutClear(rts_port_g, rts_pin_g);
 
-    uint8_t idx = EUSART_NUM(g_485);
-    GPIO->EUSARTROUTE[idx].TXROUTE =
-        (cfg->tx_port << _GPIO_EUSART_TXROUTE_PORT_SHIFT) |
-        (cfg->tx_pin  << _GPIO_EUSART_TXROUTE_PIN_SHIFT);
-    GPIO->EUSARTROUTE[idx].RXROUTE =
-        (cfg->rx_port << _GPIO_EUSART_RXROUTE_PORT_SHIFT) |
-        (cfg->rx_pin  << _GPIO_EUSART_RXROUTE_PIN_SHIFT);
-    GPIO->EUSARTROUTE[idx].ROUTEEN =
-        GPIO_EUSART_ROUTEEN_TXPEN | GPIO_EUSART_ROUTEEN_RXPEN;
+    const eusart_config_t ecfg = {
+        .eusart    = cfg->eusart,
+        .tx_port   = cfg->tx_port, .tx_pin = cfg->tx_pin,
+        .rx_port   = cfg->rx_port, .rx_pin = cfg->rx_pin,
+        .rx_filter = true,
+        .baudrate  = cfg->baudrate,
+        .rx_buf    = rx_buf_485, .rx_size = sizeof(rx_buf_485),
+        .rx_by_dma = true,
+        .rx_hook   = rx_irq,
+        .tx_hook   = tx_irq,
+    };
+    if (eusart_port_init(&port_485, &ecfg) != 0) {
+        LOG_ERROR("[RS485] no such EUSART instance");
+        return -1;
+    }
 
-    EUSART_UartInit_TypeDef init = EUSART_UART_INIT_DEFAULT_HF;
-    init.baudrate = cfg->baudrate;
+    g_baud = cfg->baudrate;
+    uart485_set_frame_gap_us(UART485_FRAME_GAP_US ? UART485_FRAME_GAP_US
+                                                  : frame_gap_us_for(cfg->baudrate));
 
-    EUSART_UartInitHf(g_485, &init);
+    if (eusart_dma_alloc(&port_485) != 0) {
+        LOG_ERROR("[RS485] DMA setup failed, bus disabled");
+        return -1;
+    }
+    Ecode_t ec = DMADRV_PeripheralMemoryPingPong(port_485.rx_dma_ch, eusart_dma_rx_signal(&port_485),
+                                                 rx_dma_buf[0], rx_dma_buf[1], (void *)&g_485->RXDATA, true,
+                                                 UART485_RX_DMA_BUF, dmadrvDataSize1, rx_dma_done, NULL);
+    if (ec != ECODE_EMDRV_DMADRV_OK) {
+        LOG_ERROR("[RS485] RX DMA start failed, ecode=0x%lx, bus disabled", (unsigned long)ec);
+        return -1;
+    }
+    dma_ready = true;
+
+    // RX timeout ends frames, RXOF counts hardware FIFO overflows; TXC is enabled per frame
+    EUSART_IntEnable(g_485, EUSART_IEN_RXTO | EUSART_IEN_RXOF);
 
-    // Enable RX interrupt
-    EUSART_IntEnable(g_485, EUSART_IEN_RXFL);
+    // Same priority as the LDMA so a flush and a buffer switch never interleave
+    NVIC_SetPriority(eusart_rx_irqn(&port_485), EMDRV_DMADRV_DMA_IRQ_PRIORITY);
+    return 0;
+}
 
-    NVIC_EnableIRQ(EUSART1_RX_IRQn); // Adjust instance
+void uart485_set_baudrate(uint32_t baudrate)
+{
+    while (tx_busy);
+    EUSART_BaudrateSet(g_485, 0, baudrate);
+    g_baud = baudrate;
+    uart485_set_frame_gap_us(UART485_FRAME_GAP_US ? UART485_FRAME_GAP_US : frame_gap_us_for(baudrate));
 }
 
-void uart485_send(const uint8_t *data, uint16_t len)
+/* LDMA has queued the last byte into the FIFO; let TXC tell us when it is on the wire */
+static bool tx_dma_done(unsigned int channel, unsigned int sequenceNo, void *userParam)
 {
+    (void)channel; (void)sequenceNo; (void)userParam;
+    EUSART_IntClear(g_485, EUSART_IF_TXC);
+    EUSART_IntEnable(g_485, EUSART_IEN_TXC);
+    return false;
+}
+
+int uart485_send(const uint8_t *data, uint16_t len, uart485_tx_done_cb_t done)
+{
+    if (!dma_ready || len == 0 || len > DMADRV_MAX_XFER_COUNT) return -1;
+
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_ATOMIC();
+    bool busy = tx_busy;
+    tx_busy = true;
+    CORE_EXIT_ATOMIC();
+    if (busy) return -1;
+
+    tx_done_cb = done;
     GPIO_PinOutSet(rts_port_g, rts_pin_g);   // Enable driver
 
-    for (uint16_t i = 0; i < len; i++) {
-        EUSART_Tx(g_485, data[i]);
-        while (!(g_485->STATUS & EUSART_STATUS_TXIDLE));
+    Ecode_t ec = DMADRV_MemoryPeripheral(port_485.tx_dma_ch, eusart_dma_tx_signal(&port_485),
+                                         (void *)&g_485->TXDATA, (void *)data, true, len,
+                                         dmadrvDataSize1, tx_dma_done, NULL);
+    if (ec != ECODE_EMDRV_DMADRV_OK) {
+        GPIO_PinOutClear(rts_port_g, rts_pin_g);
+        tx_busy = false;
+        return -1;
     }
+    return 0;
+}
 
-    GPIO_PinOutClear(rts_port_g, rts_pin_g); // Disable driver
+bool uart485_tx_busy(void)
+{
+    return tx_busy;
 }
 
 bool uart485_rx_available(void)
 {
-    return rx_h_485 != rx_t_485;
+    return ring_used(&port_485.rx) != 0;
 }
 
 uint8_t uart485_read_byte(void)
 {
-    uint8_t b = rx_buf_485[rx_t_485++];
-    rx_t_485 &= 0xFF;
+    uint8_t b = 0;
+    ring_read(&port_485.rx, &b, 1);
     return b;
 }
 
-void EUSART1_RX_IRQHandler(void)
+void uart485_register_rx_cb(uart485_rx_cb_t cb)
+{
+    g_rx_cb = cb;
+}
+
+uint32_t uart485_rx_oversize(void)
 {
-    uint32_t flags = EUSART_IntGet(g_485);
-    EUSART_IntClear(g_485, flags);
+    return oversize_frames;
+}
+
+/* Main-loop side: hand each completed frame to the callback as one buffer */
+void uart485_poll(void)
+{
+    if (!g_rx_cb) return;
+
+    while (fe_tail != fe_head) {
+        CORE_DECLARE_IRQ_STATE;
+        CORE_ENTER_ATOMIC();
+        rx_frame_end_t fe = frame_ends[fe_tail % UART485_FRAME_QUEUE];
+        fe_tail = (uint8_t)(fe_tail + 1);
+        CORE_EXIT_ATOMIC();
 
-    if (flags & EUSART_IF_RXFL) {
-        uint8_t b = EUSART_Rx(g_485);
-        rx_buf_485[rx_h_485++] = b;
-        rx_h_485 &= 0xFF;
+        bool overrun = fe.overflows != overflows_seen;
+        overflows_seen = fe.overflows;
+        uint16_t len = (uint16_t)(fe.end - port_485.rx.tail);
+
+        // A frame that can't be delivered whole is consumed without a copy
+        bool drop = overrun || fe.merged || len > sizeof(frame_buf);
+        if (len > sizeof(frame_buf)) oversize_frames++;
+
+        uint16_t left = len, got = 0;
+        while (left) {
+            const uint8_t *span;
+            uint16_t n = ring_peek(&port_485.rx, &span);
+            if (n == 0) break;
+            if (n > left) n = left;
+            if (!drop) memcpy(&frame_buf[got], span, n);
+            got = (uint16_t)(got + n);
+            ring_consume(&port_485.rx, n);
+            left = (uint16_t)(left - n);
+        }
+
+        // Lost bytes, frames run together or too long: the meter reply is unusable
+        if (!drop && got) g_rx_cb(frame_buf, got);
+    }
+}
+
+/* Everything received up to head is one frame */
+static void rx_frame_close(uint16_t head)
+{
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_ATOMIC();
+    uint32_t overflows = eusart_rx_overflows(&port_485);
+    if ((uint8_t)(fe_head - fe_tail) < UART485_FRAME_QUEUE) {
+        rx_frame_end_t *fe = &frame_ends[fe_head % UART485_FRAME_QUEUE];
+        fe->end = head;
+        fe->overflows = overflows;
+        fe->merged = false;
+        fe_head = (uint8_t)(fe_head + 1);
+    } else {
+        // No slot left: fold into the newest frame, which is then dropped whole
+        rx_frame_end_t *fe = &frame_ends[(uint8_t)(fe_head - 1) % UART485_FRAME_QUEUE];
+        fe->end = head;
+        fe->overflows = overflows;
+        fe->merged = true;
+    }
+    CORE_EXIT_ATOMIC();
+}
+
+/* End of a long gap: the frame is over unless bytes came in since the RX
+   timeout (their own RX timeout restarts the gap) */
+static void gap_timer_cb(sl_sleeptimer_timer_handle_t *handle, void *data)
+{
+    (void)handle; (void)data;
+    CORE_DECLARE_IRQ_STATE;
+    CORE_ENTER_ATOMIC();
+    rx_dma_flush();
+    if (port_485.rx.head == gap_head && !(g_485->STATUS & EUSART_STATUS_RXFL)) {
+        rx_frame_close(gap_head);
+    }
+    CORE_EXIT_ATOMIC();
+}
+
+/* EUSART RX line, via the core: RXTO ends a frame (RXOF is counted by the core) */
+static void rx_irq(eusart_port_t *port, uint32_t flags)
+{
+    if (flags & EUSART_IF_RXTO) {
+        rx_dma_flush();
+
+        // Below the watermark LDMA leaves the tail in the FIFO; read until it underflows
+        for (;;) {
+            EUSART_IntClear(port->eusart, EUSART_IF_RXUF);
+            uint8_t b = (uint8_t)port->eusart->RXDATA;
+            if (EUSART_IntGet(port->eusart) & EUSART_IF_RXUF) break;
+            ring_write(&port->rx, &b, 1);
+        }
+
+        if (gap_ext_ticks == 0) {
+            rx_frame_close(port->rx.head);
+        } else {
+            gap_head = port->rx.head;
+            sl_sleeptimer_restart_timer(&gap_timer, gap_ext_ticks, gap_timer_cb, NULL, 0, 0);
+        }
+    }
+}
+
+/* EUSART TX line: TXC means the last stop bit is out */
+static void tx_irq(eusart_port_t *port, uint32_t flags)
+{
+    if (flags & EUSART_IF_TXC) {
+        EUSART_IntDisable(port->eusart, EUSART_IEN_TXC);
+        EUSART_IntClear(port->eusart, EUSART_IF_TXC);
+        GPIO_PinOutClear(rts_port_g, rts_pin_g); // Disable driver
+        tx_busy = false;
+        if (tx_done_cb) tx_done_cb();
     }
 }
@@ -7,6 +7,37 @@
 #include "em_eusart.h"
 #include "em_gpio.h"
 
+/* RX ring; must be a power of two and hold at least one full frame */
+#ifndef UART485_RX_RING_SIZE
+#define UART485_RX_RING_SIZE 4096
+#endif
+
+/* Largest frame handed to the rx callback; longer frames are dropped */
+#ifndef UART485_FRAME_MAX
+#define UART485_FRAME_MAX 2048
+#endif
+
+/* Completed frames waiting for uart485_poll(); power of two, at most 128 */
+#ifndef UART485_FRAME_QUEUE
+#define UART485_FRAME_QUEUE 4
+#endif
+
+/* Silent interval that ends a frame; 0 = derive T3.5 from the baud rate.
+   The EUSART RX timeout covers up to 7 characters, a sleeptimer the rest. */
+#ifndef UART485_FRAME_GAP_US
+#define UART485_FRAME_GAP_US 0
+#endif
+
+/* Size of each of the two RX DMA ping-pong buffers; one interrupt per buffer */
+#ifndef UART485_RX_DMA_BUF
+#define UART485_RX_DMA_BUF 64
+#endif
+
+typedef void (*uart485_rx_cb_t)(const uint8_t *data, uint16_t len);
+
+/* Called from interrupt context once the last stop bit has left the line */
+typedef void (*uart485_tx_done_cb_t)(void);
+
 typedef struct {
     EUSART_TypeDef *eusart;
     GPIO_Port_TypeDef tx_port;
@@ -20,9 +51,37 @@ typedef struct {
     uint32_t baudrate;
 } uart485_config_t;
 
-void uart485_init(const uart485_config_t *cfg);
-void uart485_send(const uint8_t *data, uint16_t len);
+/* Returns -1 (logged) if the EUSART or its DMA can't be set up; the bus
+   then stays disabled and uart485_send() refuses every frame */
+int uart485_init(const uart485_config_t *cfg);
+
+/* Start an LDMA transmit of data and return; DE stays high until the
+   TX-complete interrupt, then done (may be NULL) is called. data must stay
+   valid until then. Returns -1 if a transmit is already running, DMA was
+   not set up, or it could not be started. */
+int uart485_send(const uint8_t *data, uint16_t len, uart485_tx_done_cb_t done);
+bool uart485_tx_busy(void);
+
+/* Change the line rate; the frame gap follows unless UART485_FRAME_GAP_US is set */
+void uart485_set_baudrate(uint32_t baudrate);
 bool uart485_rx_available(void);
 uint8_t uart485_read_byte(void);
 
+/* Frames are delimited by line silence and delivered from uart485_poll().
+   While a callback is registered the driver owns the RX ring, so don't mix
+   it with uart485_read_byte(). */
+void uart485_register_rx_cb(uart485_rx_cb_t cb);
+void uart485_set_frame_gap_us(uint32_t gap_us);
+void uart485_poll(void);
+
+/* Changes whenever received bytes reach the driver (including dropped ones);
+   lets a caller tell a slow, long frame from a silent line */
+uint32_t uart485_rx_activity(void);
+
+/* RX overflows since boot: bytes dropped by a full ring plus EUSART FIFO overruns */
+uint32_t uart485_rx_overflows(void);
+
+/* Frames dropped since boot for exceeding UART485_FRAME_MAX */
+uint32_t uart485_rx_oversize(void);
+
 #endif
@@ -1,12 +1,49 @@
 #include "stack_if.h"
 #include "log.h"
+#include "em_device.h"
 #include <string.h>
+#include <stdbool.h>
 
 #ifndef USE_WISUN_SDK
 #define USE_WISUN_SDK 0
 #endif
 
 static wsun_rx_callback_t g_rx_cb = NULL;
+static wsun_topology_callback_t g_topology_cb = NULL;
+
+/* Datagrams received in the stack's event context, handed to g_rx_cb from
+   wsun_process(). Single producer (event handler), single consumer (main
+   loop); head and tail run free and are only written by their owner. */
+#if (WSUN_RX_QUEUE_DEPTH & (WSUN_RX_QUEUE_DEPTH - 1)) || WSUN_RX_QUEUE_DEPTH > 128
+#error "WSUN_RX_QUEUE_DEPTH must be a power of two up to 128"
+#endif
+
+typedef struct {
+    uint16_t len;
+    uint8_t src[16];
+    uint8_t data[WSUN_RX_MAX];
+} wsun_rx_slot_t;
+
+static wsun_rx_slot_t rx_q[WSUN_RX_QUEUE_DEPTH];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static volatile uint32_t rx_dropped = 0;
+static volatile bool topology_changed = false;
+
+static void rx_enqueue(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6)
+{
+    uint8_t head = rx_head;
+    if ((uint8_t)(head - rx_tail) >= WSUN_RX_QUEUE_DEPTH || len > WSUN_RX_MAX) {
+        rx_dropped++;
+        return;
+    }
+    wsun_rx_slot_t *slot = &rx_q[head % WSUN_RX_QUEUE_DEPTH];
+    memcpy(slot->data, payload, len);
+    memcpy(slot->src, src_ipv6, 16);
+    slot->len = len;
+    __DMB();                        // slot contents before the index
+    rx_head = (uint8_t)(head + 1);
+}
 
 /* If your Studio project exposes an API like sl_wisun_init or sl_wisun_start,
    we will call them here when USE_WISUN_SDK=1.
@@ -15,15 +52,69 @@ static wsun_rx_callback_t g_rx_cb = NULL;
 
 #if USE_WISUN_SDK
 
-/* Try to include common Studio headers; adjust if file names differ */
-#include "sl_wisun.h"        // optional
-#include "sl_wisun_api.h"    // optional
-#include "socket_api.h"      // nanostack socket API
-#include "net_ipv6.h"
+#include "sl_wisun_api.h"
+#include "sl_wisun_events.h"
+#include "socket/socket.h"
+#ifdef BR_DEVICE
+#include "border_router/sl_wisun_br_api.h"
+#endif
+#ifdef NR_DEVICE
+#include "../app/common/meter_proto.h"
+#endif
 
 static int app_socket_fd = -1;
 static uint16_t app_port = 4000;
 
+/* Unicast destinations, built once per peer and reused for every packet */
+typedef struct {
+    sockaddr_in6_t sa;
+    uint32_t last_use;
+} wsun_peer_t;
+
+static wsun_peer_t peers[WSUN_PEER_CACHE];
+static uint32_t peer_clock = 0;
+
+static void sockaddr_build(sockaddr_in6_t *sa, const uint8_t *addr6, uint16_t port)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->sin6_family = AF_INET6;
+    sa->sin6_port = htons(port);
+    memcpy(sa->sin6_addr.address, addr6, 16);
+}
+
+/* Cached destination for addr6/port; replaces the least recently used peer */
+static const sockaddr_in6_t *peer_get(const uint8_t *addr6, uint16_t port)
+{
+    uint16_t nport = htons(port);
+    wsun_peer_t *victim = &peers[0];
+    for (int i = 0; i < WSUN_PEER_CACHE; i++) {
+        wsun_peer_t *p = &peers[i];
+        if (p->last_use && p->sa.sin6_port == nport &&
+            memcmp(p->sa.sin6_addr.address, addr6, 16) == 0) {
+            p->last_use = ++peer_clock;
+            return &p->sa;
+        }
+        if (p->last_use < victim->last_use) victim = p;
+    }
+    sockaddr_build(&victim->sa, addr6, port);
+    victim->last_use = ++peer_clock;
+    return &victim->sa;
+}
+
+static int sock_sendto(const sockaddr_in6_t *dst, const uint8_t *buf, uint16_t len)
+{
+    if (app_socket_fd < 0) {
+        LOG_ERROR("app_socket_fd invalid");
+        return -1;
+    }
+    ssize_t rc = sendto(app_socket_fd, buf, len, 0, (const struct sockaddr *)dst, sizeof(*dst));
+    return (rc == (ssize_t)len) ? 0 : -1;
+}
+
+#ifdef BR_DEVICE
+static sl_wisun_br_routing_table_entry_t route_tbl[WSUN_BR_ROUTES_MAX];
+#endif
+
 #endif
 
 void wsun_init(void)
@@ -36,8 +127,43 @@ void wsun_init(void)
     // Example (uncomment when available):
     // sl_wisun_init();
 
-    // Create socket (nanostack) if stack requires app socket
-    // app_socket_fd = ns_socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    app_socket_fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (app_socket_fd < 0) {
+        LOG_ERROR("[WSUN sdk] socket() failed");
+        return;
+    }
+    sockaddr_in6_t local;
+    memset(&local, 0, sizeof(local));
+    local.sin6_family = AF_INET6;
+    local.sin6_port = htons(app_port);
+    local.sin6_addr = in6addr_any;
+    if (bind(app_socket_fd, (const struct sockaddr *)&local, sizeof(local)) < 0) {
+        LOG_ERROR("[WSUN sdk] bind(%u) failed", (unsigned)app_port);
+    }
+
+    // Datagrams delivered in SOCKET_DATA indications; the default polling
+    // mode only announces them
+    uint32_t mode = SL_WISUN_SOCKET_EVENT_MODE_INDICATION;
+    if (setsockopt(app_socket_fd, SOL_SOCKET, SO_EVENT_MODE, &mode, sizeof(mode)) < 0) {
+        LOG_ERROR("[WSUN sdk] SO_EVENT_MODE failed");
+    }
+
+#ifdef NR_DEVICE
+    // Requests from the BR go to this group
+    ipv6_mreq_t mreq;
+    static const uint8_t group[16] = METER_NRS_MULTICAST_ADDR;
+    memset(&mreq, 0, sizeof(mreq));
+    memcpy(mreq.ipv6mr_multiaddr.address, group, 16);
+    if (setsockopt(app_socket_fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq, sizeof(mreq)) < 0) {
+        LOG_ERROR("[WSUN sdk] joining the request group failed");
+    }
+#endif
+
+    int hops = WSUN_UNICAST_HOPS;
+    setsockopt(app_socket_fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &hops, sizeof(hops));
+    hops = WSUN_MULTICAST_HOPS;
+    setsockopt(app_socket_fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+    memset(peers, 0, sizeof(peers));
 #else
     LOG_INFO("[WSUN stub] init (no SDK)");
 #endif
@@ -49,14 +175,9 @@ void wsun_start_border_router(void)
 #if USE_WISUN_SDK
     LOG_INFO("[WSUN sdk] start BR via studio helper");
 
-    // Example pseudocode using Studio provided functions:
-    // sl_wisun_br_start();
-    // bind socket:
-    // ns_sockaddr_t addr;
-    // memset(&addr, 0, sizeof(addr));
-    // addr.version = SOCKET_IPV6;
-    // addr.port = app_port;
-    // ns_bind(app_socket_fd, (const uint8_t*)&addr, sizeof(addr));
+    // Example (network name and PHY come from the Studio project):
+    // sl_wisun_br_start(name, &phy_config);
+    // The application socket is already bound in wsun_init().
 #else
     LOG_INFO("[WSUN stub] Border Router started; stub IPv6=fe80::1");
 #endif
@@ -77,13 +198,9 @@ int wsun_send_multicast(const uint8_t *addr6, uint16_t port, const uint8_t *buf,
 {
     LOG_INFO("[WSUN] send_multicast len=%u port=%u", (unsigned)len, (unsigned)port);
 #if USE_WISUN_SDK
-    if (app_socket_fd < 0) {
-        LOG_ERROR("app_socket_fd invalid");
-        return -1;
-    }
-    // Build ns_sockaddr_t dst from addr6 and port, then ns_sendto(...)
-    // ns_sendto(app_socket_fd, buf, len, 0, (const uint8_t*)&dst, sizeof(dst));
-    return 0;
+    sockaddr_in6_t dst;
+    sockaddr_build(&dst, addr6, port);
+    return sock_sendto(&dst, buf, len);
 #else
     (void)addr6; (void)port; (void)buf; (void)len;
     // stub: simulate immediate reception for development: call registered callback
@@ -95,21 +212,138 @@ int wsun_send_multicast(const uint8_t *addr6, uint16_t port, const uint8_t *buf,
 #endif
 }
 
+int wsun_send_unicast(const uint8_t *addr6, uint16_t port, const uint8_t *buf, uint16_t len)
+{
+    LOG_INFO("[WSUN] send_unicast len=%u port=%u", (unsigned)len, (unsigned)port);
+#if USE_WISUN_SDK
+    return sock_sendto(peer_get(addr6, port), buf, len);
+#else
+    (void)addr6; (void)port;
+    // stub: loop back like the multicast path
+    if (g_rx_cb) {
+        uint8_t fake_src[16] = {0xfe,0x80,0,0,0,0,0,0,0,0,0,0,0,0,0,2};
+        g_rx_cb(buf, len, fake_src);
+    }
+    return 0;
+#endif
+}
+
 void wsun_register_rx_cb(wsun_rx_callback_t cb)
 {
     g_rx_cb = cb;
 }
 
-void wsun_process(void)
+/* Own global (GUA/ULA) address; returns 0 on success, -1 if not connected yet */
+int wsun_get_global_ipv6(uint8_t addr6[16])
+{
+#if USE_WISUN_SDK
+    in6_addr_t addr;
+    if (sl_wisun_get_ip_address(SL_WISUN_IP_ADDRESS_TYPE_GLOBAL, &addr) != SL_STATUS_OK) {
+        return -1;
+    }
+    memcpy(addr6, addr.address, 16);
+    return 0;
+#else
+    // stub: same address the loopback path reports as source
+    static const uint8_t stub_addr[16] = {0xfe,0x80,0,0,0,0,0,0,0,0,0,0,0,0,0,2};
+    memcpy(addr6, stub_addr, 16);
+    return 0;
+#endif
+}
+
+/* Own DODAG rank; hop distance to the BR is roughly rank / min_hop_rank_increase */
+int wsun_get_rpl_rank(uint16_t *rank, uint16_t *min_hop_rank_increase)
 {
 #if USE_WISUN_SDK
-    // If your stack needs periodic service, call it here.
+    sl_wisun_rpl_info_t info;
+    if (sl_wisun_get_rpl_info(&info) != SL_STATUS_OK) {
+        return -1;
+    }
+    *rank = info.dodag_rank;
+    *min_hop_rank_increase = info.min_hop_rank_increase;
+    return 0;
 #else
-    // nothing in stub mode
+    // stub: two hops from the root
+    *rank = 2 * 128;
+    *min_hop_rank_increase = 128;
+    return 0;
 #endif
 }
 
+void wsun_register_topology_cb(wsun_topology_callback_t cb)
+{
+    g_topology_cb = cb;
+}
+
+int wsun_br_for_each_route(wsun_route_cb_t cb, void *ctx)
+{
+#if USE_WISUN_SDK && defined(BR_DEVICE)
+    uint16_t count = WSUN_BR_ROUTES_MAX;
+    if (sl_wisun_br_get_routing_table(&count, route_tbl) != SL_STATUS_OK) {
+        return -1;
+    }
+    if (count > WSUN_BR_ROUTES_MAX) count = WSUN_BR_ROUTES_MAX;
+    for (uint16_t i = 0; i < count; i++) {
+        cb(route_tbl[i].target.address, route_tbl[i].preferred.address, ctx);
+    }
+    return count;
+#elif USE_WISUN_SDK
+    (void)cb; (void)ctx;
+    return -1;
+#else
+    // stub: the single loopback node, parented to the BR
+    static const uint8_t stub_node[16] = {0xfe,0x80,0,0,0,0,0,0,0,0,0,0,0,0,0,2};
+    static const uint8_t stub_br[16] = {0xfe,0x80,0,0,0,0,0,0,0,0,0,0,0,0,0,1};
+    cb(stub_node, stub_br, ctx);
+    return 1;
+#endif
+}
+
+#if USE_WISUN_SDK
+/* Stack event handler (overrides the weak SDK default) */
+void sl_wisun_on_event(sl_wisun_evt_t *evt)
+{
+    switch (evt->header.id) {
+    case SL_WISUN_MSG_SOCKET_DATA_IND_ID:
+        /* Event context: copy out, the application runs from wsun_process() */
+        if (evt->evt.socket_data.socket_id == app_socket_fd) {
+            rx_enqueue(evt->evt.socket_data.data, evt->evt.socket_data.data_length,
+                       evt->evt.socket_data.remote_address.address);
+        }
+        break;
+    case SL_WISUN_MSG_NETWORK_UPDATE_IND_ID:
+    case SL_WISUN_BR_MSG_ROUTING_TABLE_UPDATE_IND_ID:
+        topology_changed = true;
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+void wsun_process(void)
+{
+    static uint32_t dropped_seen = 0;
+    if (rx_dropped != dropped_seen) {
+        LOG_WARN("[WSUN] %lu datagrams dropped, RX queue full or too long",
+                 (unsigned long)(rx_dropped - dropped_seen));
+        dropped_seen = rx_dropped;
+    }
+
+    if (topology_changed) {
+        topology_changed = false;
+        if (g_topology_cb) g_topology_cb();
+    }
+
+    while (rx_tail != rx_head) {
+        __DMB();                    // index before the slot contents
+        const wsun_rx_slot_t *slot = &rx_q[rx_tail % WSUN_RX_QUEUE_DEPTH];
+        if (g_rx_cb) g_rx_cb(slot->data, slot->len, slot->src);
+        rx_tail = (uint8_t)(rx_tail + 1);
+    }
+}
+
 void wsun_invoke_rx_cb_from_sdk(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6)
 {
-    if (g_rx_cb) g_rx_cb(payload, len, src_ipv6);
+    rx_enqueue(payload, len, src_ipv6);
 }
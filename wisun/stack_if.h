@@ -2,13 +2,53 @@
 #include <stdint.h>
 
 typedef void (*wsun_rx_callback_t)(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6);
+typedef void (*wsun_topology_callback_t)(void);
+typedef void (*wsun_route_cb_t)(const uint8_t target[16], const uint8_t parent[16], void *ctx);
+
+/* Upper bound on routing table entries read by wsun_br_for_each_route() */
+#ifndef WSUN_BR_ROUTES_MAX
+#define WSUN_BR_ROUTES_MAX 1024
+#endif
+
+/* Unicast peers whose socket address is kept ready-built */
+#ifndef WSUN_PEER_CACHE
+#define WSUN_PEER_CACHE 8
+#endif
+
+/* Received datagrams waiting for wsun_process(), and the largest one kept
+   (IPv6 minimum MTU); the depth must be a power of two */
+#ifndef WSUN_RX_QUEUE_DEPTH
+#define WSUN_RX_QUEUE_DEPTH 8
+#endif
+#ifndef WSUN_RX_MAX
+#define WSUN_RX_MAX 1280
+#endif
+
+/* Hop limits applied to the application socket */
+#ifndef WSUN_UNICAST_HOPS
+#define WSUN_UNICAST_HOPS 64
+#endif
+#ifndef WSUN_MULTICAST_HOPS
+#define WSUN_MULTICAST_HOPS 16
+#endif
 
 void wsun_init(void);
 void wsun_start_border_router(void);
 void wsun_start_node_router(void);
 int  wsun_send_multicast(const uint8_t *addr6, uint16_t port, const uint8_t *buf, uint16_t len);
+int  wsun_send_unicast(const uint8_t *addr6, uint16_t port, const uint8_t *buf, uint16_t len);
+/* cb runs from wsun_process(), never in the stack's event context */
 void wsun_register_rx_cb(wsun_rx_callback_t cb);
+int  wsun_get_global_ipv6(uint8_t addr6[16]);
+int  wsun_get_rpl_rank(uint16_t *rank, uint16_t *min_hop_rank_increase);
+
+/* BR only: called on network/routing table update indications */
+void wsun_register_topology_cb(wsun_topology_callback_t cb);
+/* BR only: invoke cb for every routing table entry; returns entry count or -1 */
+int  wsun_br_for_each_route(wsun_route_cb_t cb, void *ctx);
+/* Main-loop service: delivers queued datagrams and topology updates */
 void wsun_process(void);
 
-/* Helper used by SDK-based receive path to deliver payloads to app */
+/* Helper used by SDK-based receive path to deliver payloads to app (queued,
+   delivered by wsun_process()) */
 void wsun_invoke_rx_cb_from_sdk(const uint8_t *payload, uint16_t len, const uint8_t *src_ipv6);